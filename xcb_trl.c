@@ -20,6 +20,7 @@
 #include <xcb/xcb_keysyms.h>
 #include <xcb/xcb_cursor.h>
 #include <xcb/xinerama.h>
+#include <xcb/randr.h>
 #include <xcb/xcb_xrm.h>
 #include <xcb/xcb_errors.h>
 
@@ -29,8 +30,22 @@
 #include <X11/Xproto.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 
 typedef uint8_t  u8;
@@ -53,961 +68,4453 @@ static void (*_handler)(XCBDisplay *, XCBGenericError *) = NULL;
     #endif
 #endif
 
-/* HELPER FUNCTION */
-static XCBScreen *
-screen_of_display(XCBDisplay *display, int screen)
-{
-    xcb_screen_iterator_t iter;
+#ifdef DBG
+    #if XCB_TRL_ENABLE_DEFERRED_CHECK != 0
+    #define DEFERRED_CK     1
+    #endif
+#endif
+
+#ifdef XCB_TRL_ENABLE_ATOM_CACHE
+    #if XCB_TRL_ENABLE_ATOM_CACHE != 0
+    #define ATOM_CACHE      1
+    #endif
+#endif
+
+/* Per display data.
+ * XCBDisplay is just xcb's opaque connection, so anything we want to remember about a display lives here instead.
+ * Looked up by the connection pointer, most recently used display is kept at the front so the common
+ * case (1 display) is a single compare.
+ */
 
-    iter = xcb_setup_roots_iterator(xcb_get_setup(display));
-    for(; iter.rem; --screen, xcb_screen_next(&iter))
+/* keys 0 and _XCB_MAP_TOMB are reserved, XID's, atoms and keysyms are all 29 bits so neither can occur */
+#define _XCB_MAP_TOMB       UINT32_MAX
+
+typedef struct _XCBMap _XCBMap;
+typedef struct _XCBAtomEntry _XCBAtomEntry;
+typedef struct _XCBAtomTable _XCBAtomTable;
+typedef struct _XCBAtomCache _XCBAtomCache;
+typedef struct _XCBErrorRing _XCBErrorRing;
+typedef struct _XCBCheck _XCBCheck;
+typedef struct _XCBCoalescer _XCBCoalescer;
+typedef struct _XCBPayloads _XCBPayloads;
+typedef struct _XCBReader _XCBReader;
+typedef struct _XCBGeometry _XCBGeometry;
+typedef struct _XCBConfigCache _XCBConfigCache;
+typedef struct _XCBMirror _XCBMirror;
+typedef struct _XCBPropEntry _XCBPropEntry;
+typedef struct _XCBPropCache _XCBPropCache;
+typedef struct _XCBKeymap _XCBKeymap;
+typedef struct _XCBModmap _XCBModmap;
+typedef struct _XCBScreenInfo _XCBScreenInfo;
+typedef struct _XCBVisualInfo _XCBVisualInfo;
+typedef struct _XCBScreenTable _XCBScreenTable;
+typedef struct _XCBMonitorSet _XCBMonitorSet;
+typedef struct _XCBMonitorCache _XCBMonitorCache;
+typedef struct _XCBCheckTable _XCBCheckTable;
+typedef struct _XCBPendingReply _XCBPendingReply;
+typedef struct _XCBReplyQueue _XCBReplyQueue;
+typedef struct _XCBDisplayData _XCBDisplayData;
+
+struct _XCBMap
+{
+    u32 *keys;
+    void **vals;
+    u32 cap;            /* always a power of 2 */
+    u32 len;
+    u32 used;           /* len + tombstones */
+};
+
+struct _XCBAtomEntry
+{
+    const char *name;
+    u32 len;
+    u32 hash;
+    XCBAtom atom;       /* XCB_NONE if unresolved */
+    u32 cookie;         /* sequence of the InternAtom request in flight */
+    u8 pending;         /* cookie is valid */
+    u8 owned;           /* name was allocated by us */
+};
+
+struct _XCBAtomTable
+{
+    _XCBAtomEntry *entries;
+    u32 entries_len;
+    u32 entries_cap;
+    i32 *names;         /* open addressed by name hash, index into entries, -1 is empty */
+    u32 names_cap;
+    _XCBMap atoms;      /* atom -> (entries index + 1) */
+    u8 dirty;           /* learned atoms since open */
+};
+
+struct _XCBAtomCache
+{
+    char *path;         /* NULL if there is no cache for this display */
+    char *key;
+    u32 key_len;
+    u32 verify;         /* sequence of the GetAtomName spot check */
+    XCBAtom verify_atom;
+    u8 verifying;       /* verify is valid */
+    void *map;          /* cache file, loaded names point into this */
+    size_t map_len;
+};
+
+struct _XCBPendingReply
+{
+    u64 sequence;
+    XCBReplyCallback callback;
+    void *data;
+};
+
+struct _XCBReplyQueue
+{
+    _XCBPendingReply *items;    /* items[head..len) are pending, sorted by sequence */
+    u32 head;
+    u32 len;            /* 0 when empty */
+    u32 cap;
+    u64 last;           /* newest sequence registered (or written, before any was), 32 bit cookies are widened against this */
+};
+
+/* Any thread reading replies or events stores (serialized by store), single consumer (XCBDrainErrors()), errors are stored by value. */
+#define _XCB_ERROR_RING         256     /* must be a power of 2 */
+
+struct _XCBErrorRing
+{
+    XCBGenericError errors[_XCB_ERROR_RING];
+    pthread_mutex_t store;  /* producers only, the drain never takes it */
+    _Atomic u32 head;       /* next write */
+    _Atomic u32 tail;       /* next read */
+    _Atomic u32 dropped;    /* ring was full */
+    u32 suppressed;         /* over the rate limit */
+    u8 enabled;
+    u16 limits[256];        /* per error_code per second, 0 is unlimited */
+    u16 counts[256];        /* per error_code in the current window */
+    u64 window;             /* start of the current window in ms */
+};
+
+/* Requests made with DEFERRED_CK, oldest first, completed ones are polled off the tail. */
+#define _XCB_CHECK_TABLE        4096    /* must be a power of 2 */
+
+struct _XCBCheck
+{
+    u32 sequence;
+    u32 time;           /* ms, only ever compared as a difference */
+    const char *func;
+};
+
+struct _XCBCheckTable
+{
+    _XCBCheck *checks;  /* allocated on first use, not every display is checked */
+    u32 head;
+    u32 tail;
+    u32 evicted;        /* checks thrown away unread because the table was full */
+};
+
+struct _XCBCoalescer
+{
+    XCBGenericEvent **events;   /* reduced batch, events[head..len) are left to deliver, NULL where merged away */
+    u32 head;
+    u32 len;
+    u32 cap;
+    _XCBMap configures;         /* window -> (events index + 1) of its ConfigureNotify in this batch */
+    _XCBMap exposes;            /* window -> XCBExposeEvent * being unioned, kept across batches */
+    XCBCoalesceStats stats;
+    u8 enabled;
+};
+
+struct _XCBPayloads
+{
+    u8 *data;                   /* GenericEvent payloads of the last XCBPollForEvents() */
+    u32 size;
+    u32 cap;
+    u32 *index;                 /* pairs of (slot, offset into data), in slot order */
+    u32 len;
+    u32 index_cap;
+};
+
+/* Single producer (the reader thread), single consumer (the event functions). */
+struct _XCBReader
+{
+    XCBGenericEvent **ring;
+    u32 mask;                   /* ring size - 1, ring size is a power of 2 */
+    _Atomic u32 head;           /* next write */
+    _Atomic u32 tail;           /* next read */
+    _Atomic u8 done;            /* reader exited, stopped or connection error */
+    _Atomic u8 stopping;
+    int ready;                  /* eventfd, signaled when the ring stops being empty */
+    int space;                  /* eventfd, signaled when the ring stops being full */
+    XCBWindow window;           /* private InputOnly window, a ClientMessage to it stops the reader */
+    XCBDisplay *display;
+    pthread_t thread;
+    u8 joined;
+    XCBGenericEvent **stash;    /* taken out of the ring while stopping, delivered first */
+    u32 stash_head;
+    u32 stash_len;
+    u32 stash_cap;
+};
+
+/* x, y, width, height, border_width; the low 5 XCB_CONFIG_WINDOW_* bits */
+#define _XCB_GEOMETRY_MASK      0x1f
+
+struct _XCBGeometry
+{
+    u32 shadow[5];              /* last seen in a ConfigureNotify */
+    u32 pending[5];             /* not sent yet */
+    u16 fence;                  /* sequence of the last configure sent, older notifies are stale */
+    u8 inflight;                /* a configure went out and its notify has not come back yet */
+    u8 known;                   /* XCB_CONFIG_WINDOW_* bits of shadow that are valid */
+    u8 dirty;                   /* XCB_CONFIG_WINDOW_* bits of pending to send */
+    u8 listed;                  /* window is in the dirty list */
+};
+
+struct _XCBConfigCache
+{
+    _XCBMap windows;            /* window -> _XCBGeometry * */
+    XCBWindow *dirty;           /* windows with something pending, in order of their first change */
+    u32 len;
+    u32 cap;
+    u8 enabled;
+};
+
+struct _XCBMirror
+{
+    _XCBMap windows;            /* window -> XCBWindowState * */
+    u32 interval;               /* self check in ms, 0 is off */
+    u64 checked;                /* last self check in ms */
+    u8 enabled;
+};
+
+struct _XCBPropEntry
+{
+    _XCBPropEntry *next;        /* same window */
+    _XCBPropEntry *newer;
+    _XCBPropEntry *older;
+    XCBWindow window;
+    XCBAtom property;
+    XCBAtom req_type;
+    XCBAtom type;
+    u32 length;                 /* bytes of data */
+    u32 format;                 /* not u8, keeps data aligned for 32 bit items */
+    u8 data[];                  /* the value alone, 8/16/32 bit items packed as the server sent them */
+};
+
+struct _XCBPropCache
+{
+    _XCBMap windows;            /* window -> _XCBPropEntry * list, only while it has any */
+    _XCBPropEntry *newest;
+    _XCBPropEntry *oldest;
+    _XCBPropEntry *lent;        /* last handed out by XCBGetCachedProperty(), kept until the next lookup */
+    size_t bytes;
+    size_t max;
+    u8 orphan;                  /* lent is in no list anymore (never cached or dropped since), the next lookup frees it */
+    u8 enabled;
+};
+
+/* A position is (keycode - min) * width + column */
+struct _XCBKeymap
+{
+    XCBKeysym *syms;            /* rows of width, as XCBKeySymbolsGetKeySym() would return them */
+    u16 *next;                  /* position + 1 of the next with the same keysym, 0 ends */
+    _XCBMap index;              /* keysym -> first position + 1 */
+    u8 min;
+    u8 max;
+    u8 per;                     /* keysyms per keycode the server gave */
+    u8 width;                   /* per, at least 4 for the 2 groups */
+    u8 first;                   /* keycodes changed by MappingNotify, refetched on the next lookup */
+    u8 last;
+    u8 dirty;
+    u8 loaded;
+};
+
+/* The modifier mapping, masks are derived through the keymap */
+struct _XCBModmap
+{
+    u8 modifiers[256];          /* keycode -> mask of the modifiers it is on */
+    u16 num_lock;
+    u16 scroll_lock;
+    u16 mode_switch;
+    u8 dirty;                   /* MappingNotify for modifiers, refetched on the next lookup */
+    u8 stale;                   /* MappingNotify for keyboard, masks derived again on the next lookup */
+    u8 loaded;
+};
+
+/* Copied out of the setup, so the getters index an array instead of walking the screen list */
+struct _XCBScreenInfo
+{
+    XCBScreen *screen;
+    XCBWindow root;
+    XCBVisual root_visual;
+    u32 black_pixel;
+    u32 white_pixel;
+    u16 width;
+    u16 height;
+    u8 depth;
+};
+
+struct _XCBVisualInfo
+{
+    xcb_visualtype_t *visual;
+    u8 depth;
+    u8 screen;
+};
+
+/* Built once per display, the setup lives as long as the connection */
+struct _XCBScreenTable
+{
+    _XCBScreenInfo *screens;    /* visuals follow in the same allocation */
+    _XCBVisualInfo *visuals;
+    _XCBMap index;              /* visual id -> _XCBVisualInfo * */
+    u32 count;
+    u32 nvisuals;
+};
+
+/* An immutable snapshot of the monitors, 1 allocation: this, the monitors, then the grid.
+ * The distinct monitor edges cut the screen into cells, each naming the first monitor covering it.
+ */
+struct _XCBMonitorSet
+{
+    XCBMonitors pub;            /* what XCBGetMonitors() hands out */
+    i32 *xs;                    /* sorted distinct left/right edges */
+    i32 *ys;                    /* sorted distinct top/bottom edges */
+    i16 *cells;                 /* ny - 1 rows of nx - 1, monitor index or -1 */
+    u32 nx;
+    u32 ny;
+};
+
+struct _XCBMonitorCache
+{
+    _XCBMonitorSet *current;
+    XCBWindow root;
+    u32 serial;
+    u8 first_event;             /* RandR event base, 0 without RandR */
+    u8 dirty;                   /* RandR notify (or root ConfigureNotify), rebuilt on the next XCBRefreshMonitors() */
+    u8 enabled;
+};
+
+struct _XCBDisplayData
+{
+    XCBDisplay *display;
+    _XCBAtomTable atoms;
+    _XCBAtomCache cache;
+    _XCBReplyQueue replies;
+    _XCBErrorRing errors;
+    _XCBCheckTable checks;
+    _XCBCoalescer coalesce;
+    _XCBPayloads payloads;
+    XCBGenericEvent *ahead;     /* read ahead by a mirror check that backed off, handed out before anything else */
+    _XCBReader *reader;
+    u32 readers;                /* XCBStartEventThread() count, tells one reader from the next */
+    _XCBConfigCache configs;
+    _XCBMirror mirror;
+    _XCBPropCache props;
+    _XCBKeymap keymap;
+    _XCBModmap modmap;
+    _XCBScreenTable screens;
+    _XCBMonitorCache monitors;
+    XCBIOErrorHandler io_handler;
+    u8 io_reported;
+    pthread_mutex_t lock;       /* recursive, see XCBLockDisplay() */
+    pthread_mutex_t stage;      /* guards the 2 below, see _xcb_stage_return() */
+    pthread_cond_t staged;      /* signalled when a batch is written */
+    u8 stage_writing;           /* XCBFlushStaged() is in xcb_writev() */
+    u8 stage_returned;          /* the socket was asked back since XCBFlushStaged() took it */
+    u32 id;                     /* unique per display data, a new display may get a closed ones address */
+    _XCBDisplayData *next;
+};
+
+static _XCBDisplayData *_dpys = NULL;
+static pthread_mutex_t _dpys_lock = PTHREAD_MUTEX_INITIALIZER;
+static u32 _dpys_id = 0;
+static _Atomic u32 _dpys_freed = 0;     /* bumped by every _xcb_dpy_free(), invalidates the screen table hints */
+/* last screen table looked up by this thread, the screen getters skip _dpys_lock with it */
+static _Thread_local XCBDisplay *_screens_display = NULL;
+static _Thread_local _XCBScreenTable *_screens_table = NULL;
+static _Thread_local u32 _screens_freed = 0;
+
+static u32
+_xcb_hash32(u32 x)
+{
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
+static u32
+_xcb_hash_str(const char *str, u32 len)
+{
+    /* FNV-1a */
+    u32 hash = 2166136261u;
+    u32 i;
+    for(i = 0; i < len; ++i)
     {
-        if(screen == 0)
-        {   return iter.data;
-        }
+        hash ^= (u8)str[i];
+        hash *= 16777619u;
     }
-    return NULL;
+    return hash;
 }
 
-#ifdef DBG
-static void
-jmpck(XCBDisplay *d, XCBGenericError *err)
+static int
+_xcb_map_grow(_XCBMap *map)
 {
-    fprintf(stderr, "%s %s\n", XCBErrorCodeText(err->error_code), XCBErrorMajorCodeText(err->major_code));
-    fprintf(stderr, 
-            "error_code:    [%d]\n"
-            "major_code:    [%d]\n"
-            "minor_code:    [%d]\n"
-            "sequence:      [%d]\n"
-            "response_type: [%d]\n"
-            "resource_id:   [%d]\n"
-            "full_sequence: [%d]\n"
-              ,
-           err->error_code, err->major_code, err->minor_code, 
-           err->sequence, err->response_type, err->resource_id, 
-           err->full_sequence);
-
-}
+    const u32 cap = map->cap ? map->cap << 1 : 16;
+    u32 *keys = calloc(cap, sizeof(u32));
+    void **vals = calloc(cap, sizeof(void *));
+    u32 i;
+    u32 j;
 
-static void
-ck(XCBDisplay *d, XCBCookie c, const char *func)
-{
-    if(!d || !c.sequence)   /* sequence shouldnt and cant be 0, so we dont handle that */
-    {   
-        fprintf(stderr, "Could not load display into error handler.");
-        XCBBreakPoint();
-        return;
+    if(!keys || !vals)
+    {
+        free(keys);
+        free(vals);
+        return 0;
     }
-    XCBGenericError *err = NULL;
-    err = xcb_request_check(d, c);
-    if(err)
+    for(i = 0; i < map->cap; ++i)
     {
-        jmpck(d, err);
-        fprintf(stderr, "Occured at: %s\n", func);
-        /* to retain some functionaly we just push these to the event queue */
-        const XCBScreen *scr = xcb_setup_roots_iterator(xcb_get_setup(d)).data;
-        if(scr && scr->root)   
+        if(map->keys[i] && map->keys[i] != _XCB_MAP_TOMB)
         {
-            XCBGenericError r;
-            memcpy(&r, err, sizeof(XCBGenericError));
-            xcb_send_event(d, 0, scr->root, XCB_EVENT_MASK_NO_EVENT, (char *)&r);
+            j = _xcb_hash32(map->keys[i]) & (cap - 1);
+            while(keys[j])
+            {   j = (j + 1) & (cap - 1);
+            }
+            keys[j] = map->keys[i];
+            vals[j] = map->vals[i];
         }
-        free(err);
-        XCBFlush(d);
-        XCBBreakPoint();
     }
+    free(map->keys);
+    free(map->vals);
+    map->keys = keys;
+    map->vals = vals;
+    map->cap = cap;
+    map->used = map->len;
+    return 1;
 }
 
-void  
-XCBBreakPoint(void) 
-{
-}
-
-#endif
-
-
-static void
-_xcb_err_handler(XCBDisplay *display, XCBGenericError *err)
+/* RETURN: pointer to value slot of key, NULL if key not in map. */
+static void **
+_xcb_map_get(_XCBMap *map, u32 key)
 {
-    /* FIXME/TODO */
-    if(!err || !display)
-    {   return;
+    u32 i;
+    if(!map->len)
+    {   return NULL;
     }
-#ifdef DBG
-    jmpck(display, err);
-    free(err);
-    return;
-#endif
-    if(_handler)
-    {   _handler(display, err);
+    i = _xcb_hash32(key) & (map->cap - 1);
+    while(map->keys[i])
+    {
+        if(map->keys[i] == key)
+        {   return &map->vals[i];
+        }
+        i = (i + 1) & (map->cap - 1);
     }
-    free(err);
-    err = NULL;
+    return NULL;
 }
 
-XCBDisplay *
-XCBOpenDisplay(const char *displayName, int *defaultScreenReturn)
+/* RETURN: pointer to value slot of key, slot is NULL if newly created.
+ * RETURN: NULL on Failure (alloc).
+ */
+static void **
+_xcb_map_set(_XCBMap *map, u32 key)
 {
-    XCBDisplay *display = xcb_connect(displayName, defaultScreenReturn);
-    /* We need to check return type cause xcb_connect never returns NULL (for some reason).
-     * So we just check error, which requires display.
-     */
-    if(!display || xcb_connection_has_error(display))
-    {   
-        /* This frees the connection data that was allocated. */
-        xcb_disconnect(display);
-        return NULL;
+    void **slot = _xcb_map_get(map, key);
+    u32 i;
+
+    if(slot)
+    {   return slot;
     }
-    return display;
-}
-XCBDisplay *
-XCBOpenConnection(const char *displayName, int *defaultScreenReturn)
-{
-    return xcb_connect(displayName, defaultScreenReturn);
-}
-void 
-XCBCloseDisplay(XCBDisplay *display)
-{
-    /* Closes connection and frees resulting data. */
-    xcb_disconnect(display);
+    /* keep load under 3/4 */
+    if((map->used + 1) * 4 >= map->cap * 3 && !_xcb_map_grow(map))
+    {   return NULL;
+    }
+    i = _xcb_hash32(key) & (map->cap - 1);
+    while(map->keys[i] && map->keys[i] != _XCB_MAP_TOMB)
+    {   i = (i + 1) & (map->cap - 1);
+    }
+    map->used += !map->keys[i];
+    ++map->len;
+    map->keys[i] = key;
+    map->vals[i] = NULL;
+    return &map->vals[i];
 }
 
-int 
-XCBDisplayNumber(XCBDisplay *display)
+/* RETURN: old value of key, NULL if none. */
+static void *
+_xcb_map_del(_XCBMap *map, u32 key)
 {
-    /* gets the file descriptor AKA the connection number */
-    return xcb_get_file_descriptor(display);
+    void **slot = _xcb_map_get(map, key);
+    void *val;
+    if(!slot)
+    {   return NULL;
+    }
+    val = *slot;
+    map->keys[slot - map->vals] = _XCB_MAP_TOMB;
+    *slot = NULL;
+    --map->len;
+    return val;
 }
 
-int
-XCBConnectionNumber(XCBDisplay *display)
+static void
+_xcb_map_wipe(_XCBMap *map)
 {
-    /* gets the file descriptor AKA the connection number */
-    return xcb_get_file_descriptor(display);
+    free(map->keys);
+    free(map->vals);
+    memset(map, 0, sizeof(_XCBMap));
 }
 
-XCBScreen *
-XCBScreenOfDisplay(XCBDisplay *display, int screen)
+/* Empties map, keeping its memory. */
+static void
+_xcb_map_clear(_XCBMap *map)
 {
-    return xcb_aux_get_screen(display, screen);
+    if(map->cap)
+    {   memset(map->keys, 0, map->cap * sizeof(u32));
+    }
+    map->len = 0;
+    map->used = 0;
 }
 
-XCBScreen *
-XCBDefaultScreenOfDisplay(XCBDisplay *display, int screen)
+static i32
+_xcb_atom_find(_XCBAtomTable *table, const char *name, u32 len, u32 hash)
 {
-    return screen_of_display(display, screen);
+    u32 i;
+    i32 index;
+    if(!table->names_cap)
+    {   return -1;
+    }
+    i = hash & (table->names_cap - 1);
+    while((index = table->names[i]) != -1)
+    {
+        const _XCBAtomEntry *entry = &table->entries[index];
+        if(entry->hash == hash && entry->len == len && !memcmp(entry->name, name, len))
+        {   return index;
+        }
+        i = (i + 1) & (table->names_cap - 1);
+    }
+    return -1;
 }
 
-
-int 
-XCBScreenCount(XCBDisplay *display)
+static int
+_xcb_atom_rehash(_XCBAtomTable *table, u32 cap)
 {
-    return xcb_setup_roots_iterator (xcb_get_setup (display)).rem;
+    i32 *names = malloc(cap * sizeof(i32));
+    u32 i;
+    u32 j;
+    if(!names)
+    {   return 0;
+    }
+    for(i = 0; i < cap; ++i)
+    {   names[i] = -1;
+    }
+    for(i = 0; i < table->entries_len; ++i)
+    {
+        j = table->entries[i].hash & (cap - 1);
+        while(names[j] != -1)
+        {   j = (j + 1) & (cap - 1);
+        }
+        names[j] = i;
+    }
+    free(table->names);
+    table->names = names;
+    table->names_cap = cap;
+    return 1;
 }
 
-char *
-XCBServerVendor(XCBDisplay *display)
+/* Adds name to the table, name is NOT checked for duplicates.
+ * owned:   1       name is copied.
+ *          0       name must outlive the table.
+ *
+ * RETURN: index into entries on Success.
+ * RETURN: -1 on Failure.
+ */
+static i32
+_xcb_atom_insert(_XCBAtomTable *table, const char *name, u32 len, u32 hash, XCBAtom atom, u8 owned)
 {
-    char *vendor = NULL;
-    int length = 0;
+    _XCBAtomEntry *entry;
+    char *copy = NULL;
+    u32 i;
 
-    length = xcb_setup_vendor_length (xcb_get_setup (display));
-    vendor = (char *)malloc (length + 1);
-    if (vendor)
+    if(table->entries_len == table->entries_cap)
     {
-        memcpy (vendor, xcb_setup_vendor (xcb_get_setup (display)), length);
-        vendor[length] = '\0';
+        const u32 cap = table->entries_cap ? table->entries_cap << 1 : 128;
+        _XCBAtomEntry *entries = realloc(table->entries, cap * sizeof(_XCBAtomEntry));
+        if(!entries)
+        {   return -1;
+        }
+        table->entries = entries;
+        table->entries_cap = cap;
     }
-    return vendor;
+    if((table->entries_len + 1) * 2 > table->names_cap && !_xcb_atom_rehash(table, table->names_cap ? table->names_cap << 1 : 256))
+    {   return -1;
+    }
+    if(owned)
+    {
+        copy = malloc(len + 1);
+        if(!copy)
+        {   return -1;
+        }
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+        name = copy;
+    }
+    if(atom)
+    {
+        void **slot = _xcb_map_set(&table->atoms, atom);
+        if(!slot)
+        {
+            free(copy);
+            return -1;
+        }
+        *slot = (void *)(uintptr_t)(table->entries_len + 1);
+    }
+    entry = &table->entries[table->entries_len];
+    entry->name = name;
+    entry->len = len;
+    entry->hash = hash;
+    entry->atom = atom;
+    entry->cookie = 0;
+    entry->pending = 0;
+    entry->owned = owned;
+
+    i = hash & (table->names_cap - 1);
+    while(table->names[i] != -1)
+    {   i = (i + 1) & (table->names_cap - 1);
+    }
+    table->names[i] = table->entries_len;
+    return table->entries_len++;
 }
 
-
-/* All of these use xcb_get_setup
- * The reason we can is because the access is essential O(1)
- * This is because xcb_get_setup() simply calls a error check and returns a adress
- * display->setup basically
- */
-
-int 
-XCBProtocolVersion(XCBDisplay *display)
+static void
+_xcb_atom_resolve(_XCBAtomTable *table, i32 index, XCBAtom atom)
 {
-    return xcb_get_setup(display)->protocol_major_version;
-}
+    _XCBAtomEntry *entry = &table->entries[index];
+    void **slot;
 
-int 
-XCBProtocolRevision(XCBDisplay *display)
-{   return xcb_get_setup(display)->protocol_minor_version;
+    entry->pending = 0;
+    entry->atom = atom;
+    if(atom && (slot = _xcb_map_set(&table->atoms, atom)))
+    {   
+        *slot = (void *)(uintptr_t)(index + 1);
+        table->dirty = 1;
+    }
 }
 
-int
-XCBVendorRelease(XCBDisplay *display)
-{   return xcb_get_setup (display)->release_number;
-}
+/* Remembers name as the name of atom, from a GetAtomName reply.
+ *
+ * RETURN: Stored name on Success.
+ * RETURN: NULL on Failure.
+ */
+static const char *
+_xcb_atom_learn(_XCBAtomTable *table, XCBAtom atom, const char *name, u32 len)
+{
+    const u32 hash = _xcb_hash_str(name, len);
+    i32 index = _xcb_atom_find(table, name, len, hash);
+    void **slot;
 
-int
-XCBBitmapUnit(XCBDisplay *display)
-{   return xcb_get_setup(display)->bitmap_format_scanline_unit;
+    if(index == -1)
+    {   
+        index = _xcb_atom_insert(table, name, len, hash, atom, 1);
+        if(index == -1)
+        {   return NULL;
+        }
+    }
+    else if(table->entries[index].atom != atom)
+    {
+        /* failed lookup or a intern still in flight, a pending reply still gets collected as usual */
+        slot = _xcb_map_set(&table->atoms, atom);
+        if(!slot)
+        {   return NULL;
+        }
+        *slot = (void *)(uintptr_t)(index + 1);
+        table->entries[index].atom = atom;
+    }
+    table->dirty = 1;
+    return table->entries[index].name;
 }
 
-int
-XCBBitmapBitOrder(XCBDisplay *display)
-{   return xcb_get_setup(display)->bitmap_format_bit_order;
+static void
+_xcb_atom_wipe(_XCBAtomTable *table)
+{
+    u32 i;
+    for(i = 0; i < table->entries_len; ++i)
+    {
+        if(table->entries[i].owned)
+        {   free((char *)table->entries[i].name);
+        }
+    }
+    free(table->entries);
+    free(table->names);
+    _xcb_map_wipe(&table->atoms);
+    memset(table, 0, sizeof(_XCBAtomTable));
 }
 
-int
-XCBBitmapPad(XCBDisplay *display)
-{   return xcb_get_setup(display)->bitmap_format_scanline_pad;
+static void
+_xcb_atom_init(_XCBAtomTable *table)
+{
+    /* predefined atoms never change so we know these without asking */
+    static const char *const predefined[] =
+    {
+        [XCB_ATOM_PRIMARY] = "PRIMARY", [XCB_ATOM_SECONDARY] = "SECONDARY", [XCB_ATOM_ARC] = "ARC",
+        [XCB_ATOM_ATOM] = "ATOM", [XCB_ATOM_BITMAP] = "BITMAP", [XCB_ATOM_CARDINAL] = "CARDINAL",
+        [XCB_ATOM_COLORMAP] = "COLORMAP", [XCB_ATOM_CURSOR] = "CURSOR",
+        [XCB_ATOM_CUT_BUFFER0] = "CUT_BUFFER0", [XCB_ATOM_CUT_BUFFER1] = "CUT_BUFFER1",
+        [XCB_ATOM_CUT_BUFFER2] = "CUT_BUFFER2", [XCB_ATOM_CUT_BUFFER3] = "CUT_BUFFER3",
+        [XCB_ATOM_CUT_BUFFER4] = "CUT_BUFFER4", [XCB_ATOM_CUT_BUFFER5] = "CUT_BUFFER5",
+        [XCB_ATOM_CUT_BUFFER6] = "CUT_BUFFER6", [XCB_ATOM_CUT_BUFFER7] = "CUT_BUFFER7",
+        [XCB_ATOM_DRAWABLE] = "DRAWABLE", [XCB_ATOM_FONT] = "FONT", [XCB_ATOM_INTEGER] = "INTEGER",
+        [XCB_ATOM_PIXMAP] = "PIXMAP", [XCB_ATOM_POINT] = "POINT", [XCB_ATOM_RECTANGLE] = "RECTANGLE",
+        [XCB_ATOM_RESOURCE_MANAGER] = "RESOURCE_MANAGER", [XCB_ATOM_RGB_COLOR_MAP] = "RGB_COLOR_MAP",
+        [XCB_ATOM_RGB_BEST_MAP] = "RGB_BEST_MAP", [XCB_ATOM_RGB_BLUE_MAP] = "RGB_BLUE_MAP",
+        [XCB_ATOM_RGB_DEFAULT_MAP] = "RGB_DEFAULT_MAP", [XCB_ATOM_RGB_GRAY_MAP] = "RGB_GRAY_MAP",
+        [XCB_ATOM_RGB_GREEN_MAP] = "RGB_GREEN_MAP", [XCB_ATOM_RGB_RED_MAP] = "RGB_RED_MAP",
+        [XCB_ATOM_STRING] = "STRING", [XCB_ATOM_VISUALID] = "VISUALID", [XCB_ATOM_WINDOW] = "WINDOW",
+        [XCB_ATOM_WM_COMMAND] = "WM_COMMAND", [XCB_ATOM_WM_HINTS] = "WM_HINTS",
+        [XCB_ATOM_WM_CLIENT_MACHINE] = "WM_CLIENT_MACHINE", [XCB_ATOM_WM_ICON_NAME] = "WM_ICON_NAME",
+        [XCB_ATOM_WM_ICON_SIZE] = "WM_ICON_SIZE", [XCB_ATOM_WM_NAME] = "WM_NAME",
+        [XCB_ATOM_WM_NORMAL_HINTS] = "WM_NORMAL_HINTS", [XCB_ATOM_WM_SIZE_HINTS] = "WM_SIZE_HINTS",
+        [XCB_ATOM_WM_ZOOM_HINTS] = "WM_ZOOM_HINTS", [XCB_ATOM_MIN_SPACE] = "MIN_SPACE",
+        [XCB_ATOM_NORM_SPACE] = "NORM_SPACE", [XCB_ATOM_MAX_SPACE] = "MAX_SPACE",
+        [XCB_ATOM_END_SPACE] = "END_SPACE", [XCB_ATOM_SUPERSCRIPT_X] = "SUPERSCRIPT_X",
+        [XCB_ATOM_SUPERSCRIPT_Y] = "SUPERSCRIPT_Y", [XCB_ATOM_SUBSCRIPT_X] = "SUBSCRIPT_X",
+        [XCB_ATOM_SUBSCRIPT_Y] = "SUBSCRIPT_Y", [XCB_ATOM_UNDERLINE_POSITION] = "UNDERLINE_POSITION",
+        [XCB_ATOM_UNDERLINE_THICKNESS] = "UNDERLINE_THICKNESS", [XCB_ATOM_STRIKEOUT_ASCENT] = "STRIKEOUT_ASCENT",
+        [XCB_ATOM_STRIKEOUT_DESCENT] = "STRIKEOUT_DESCENT", [XCB_ATOM_ITALIC_ANGLE] = "ITALIC_ANGLE",
+        [XCB_ATOM_X_HEIGHT] = "X_HEIGHT", [XCB_ATOM_QUAD_WIDTH] = "QUAD_WIDTH", [XCB_ATOM_WEIGHT] = "WEIGHT",
+        [XCB_ATOM_POINT_SIZE] = "POINT_SIZE", [XCB_ATOM_RESOLUTION] = "RESOLUTION",
+        [XCB_ATOM_COPYRIGHT] = "COPYRIGHT", [XCB_ATOM_NOTICE] = "NOTICE", [XCB_ATOM_FONT_NAME] = "FONT_NAME",
+        [XCB_ATOM_FAMILY_NAME] = "FAMILY_NAME", [XCB_ATOM_FULL_NAME] = "FULL_NAME",
+        [XCB_ATOM_CAP_HEIGHT] = "CAP_HEIGHT", [XCB_ATOM_WM_CLASS] = "WM_CLASS",
+        [XCB_ATOM_WM_TRANSIENT_FOR] = "WM_TRANSIENT_FOR",
+    };
+    u32 i;
+    u32 len;
+    for(i = 1; i < sizeof(predefined) / sizeof(predefined[0]); ++i)
+    {
+        len = strlen(predefined[i]);
+        _xcb_atom_insert(table, predefined[i], len, _xcb_hash_str(predefined[i], len), i, 0);
+    }
 }
 
-int
-XCBImageByteOrder(XCBDisplay *display)
-{   return xcb_get_setup(display)->image_byte_order;
-}
+#ifdef ATOM_CACHE
+/* Atom cache file.
+ * Atoms are stable for the lifetime of a server, so whatever we learned gets written to $XDG_RUNTIME_DIR
+ * and the next process just maps it in.
+ *
+ * Layout:  _XCBAtomCacheHeader, key padded to 4,
+ *          then count records of { u32 atom; u32 len; char name[len + 1]; } padded to 4.
+ *
+ * The key is the display, vendor, release and the servers socket inode/ctime, which change when the server restarts.
+ * A server reset keeps the same socket though, so the newest atom in the file is spot checked with GetAtomName
+ * the first time the table is actually used.
+ */
+#define _XCB_ATOM_CACHE_MAGIC       0x4d544158      /* "XATM" */
+#define _XCB_ATOM_CACHE_VERSION     1
+#define _XCB_PAD4(x)                (((x) + 3) & ~3u)
 
-const XCBSetup *
-XCBGetSetup(XCBDisplay *display)
-{
-    return xcb_get_setup(display);
-}
+typedef struct _XCBAtomCacheHeader _XCBAtomCacheHeader;
 
-XCBScreen *
-XCBGetScreen(XCBDisplay *display)
+struct _XCBAtomCacheHeader
 {
-    return xcb_setup_roots_iterator(xcb_get_setup(display)).data;
-}
+    u32 magic;
+    u32 version;
+    u32 key_len;
+    u32 count;
+};
 
-XCBWindow
-XCBRootWindow(XCBDisplay *display, int screen)
+/* Fills in cache->key and cache->path, no side effects if there is nowhere to put the file. */
+static void
+_xcb_atom_cache_key(XCBDisplay *display, const char *displayName, _XCBAtomCache *cache)
 {
-    /* Gets the screen structure */
-    return xcb_aux_get_screen(display, screen)->root;
+    const XCBSetup *setup = xcb_get_setup(display);
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    char *host = NULL;
+    char key[512];
+    char sock[64];
+    struct stat st;
+    int dpy = 0;
+    int screen = 0;
+    int len;
+    size_t path_len;
+
+    if(!runtime || !*runtime || !setup || !xcb_parse_display(displayName, &host, &dpy, &screen))
+    {   return;
+    }
+    memset(&st, 0, sizeof(struct stat));
+    if(!*host)
+    {
+        snprintf(sock, sizeof(sock), "/tmp/.X11-unix/X%d", dpy);
+        stat(sock, &st);
+    }
+    len = snprintf(key, sizeof(key), "%s:%d\n%.*s\n%u\n%lu:%ld", host, dpy,
+            xcb_setup_vendor_length(setup), xcb_setup_vendor(setup), setup->release_number,
+            (unsigned long)st.st_ino, (long)st.st_ctime);
+    free(host);
+    if(len <= 0 || (size_t)len >= sizeof(key))
+    {   return;
+    }
+    path_len = strlen(runtime) + sizeof("/xcb-trl-atoms-") + 8;
+    cache->path = malloc(path_len);
+    cache->key = malloc(len);
+    if(!cache->path || !cache->key)
+    {
+        free(cache->path);
+        free(cache->key);
+        cache->path = NULL;
+        cache->key = NULL;
+        return;
+    }
+    snprintf(cache->path, path_len, "%s/xcb-trl-atoms-%08x", runtime, _xcb_hash_str(key, len));
+    memcpy(cache->key, key, len);
+    cache->key_len = len;
 }
 
-XCBWindow
-XCBDefaultRootWindow(XCBDisplay *display, int screen)
-{
-    XCBScreen *scr = screen_of_display(display, screen);
-    if(scr) 
-    {   return scr->root;
+static void
+_xcb_atom_cache_load(XCBDisplay *display, const char *displayName, _XCBDisplayData *dd)
+{
+    _XCBAtomCache *cache = &dd->cache;
+    _XCBAtomTable *table = &dd->atoms;
+    const _XCBAtomCacheHeader *header;
+    const u8 *data;
+    struct stat st;
+    size_t offset;
+    size_t start;
+    XCBAtom newest = XCB_NONE;
+    XCBAtom atom;
+    u32 len;
+    u32 i;
+    int fd;
+    void *map;
+
+    _xcb_atom_cache_key(display, displayName, cache);
+    if(!cache->path)
+    {   return;
     }
-    return 0; /* AKA NULL; AKA we didnt find a screen */
+    fd = open(cache->path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+    {   return;
+    }
+    if(fstat(fd, &st) || st.st_uid != getuid() || (size_t)st.st_size < sizeof(_XCBAtomCacheHeader))
+    {   
+        close(fd);
+        return;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {   return;
+    }
+    data = map;
+    header = map;
+    start = sizeof(_XCBAtomCacheHeader) + _XCB_PAD4(header->key_len);
+    if(header->magic != _XCB_ATOM_CACHE_MAGIC || header->version != _XCB_ATOM_CACHE_VERSION 
+    || header->key_len != cache->key_len || start > (size_t)st.st_size
+    || memcmp(data + sizeof(_XCBAtomCacheHeader), cache->key, cache->key_len))
+    {   goto FAILURE;
+    }
+    /* validate everything before touching the table, so a bad file changes nothing */
+    offset = start;
+    for(i = 0; i < header->count; ++i)
+    {
+        if(offset + sizeof(u32) * 2 > (size_t)st.st_size)
+        {   goto FAILURE;
+        }
+        memcpy(&atom, data + offset, sizeof(u32));
+        memcpy(&len, data + offset + sizeof(u32), sizeof(u32));
+        if(!atom || len > (size_t)st.st_size || offset + sizeof(u32) * 2 + len + 1 > (size_t)st.st_size 
+        || data[offset + sizeof(u32) * 2 + len] != '\0')
+        {   goto FAILURE;
+        }
+        offset += _XCB_PAD4(sizeof(u32) * 2 + len + 1);
+    }
+    offset = start;
+    for(i = 0; i < header->count; ++i)
+    {
+        const char *name = (const char *)data + offset + sizeof(u32) * 2;
+        u32 hash;
+        memcpy(&atom, data + offset, sizeof(u32));
+        memcpy(&len, data + offset + sizeof(u32), sizeof(u32));
+        hash = _xcb_hash_str(name, len);
+        if(_xcb_atom_find(table, name, len, hash) == -1 && !_xcb_map_get(&table->atoms, atom)
+        && _xcb_atom_insert(table, name, len, hash, atom, 0) != -1 && atom > newest)
+        {   newest = atom;
+        }
+        offset += _XCB_PAD4(sizeof(u32) * 2 + len + 1);
+    }
+    cache->map = map;
+    cache->map_len = st.st_size;
+    if(newest)
+    {
+        cache->verify_atom = newest;
+        cache->verify = xcb_get_atom_name(display, newest).sequence;
+        cache->verifying = 1;
+    }
+    return;
+FAILURE:
+    munmap(map, st.st_size);
 }
 
-u16 XCBDisplayWidth(XCBDisplay *display, int screen)
-{
-    /* Gets the screen structure */
-    return xcb_aux_get_screen(display, screen)->width_in_pixels;
-}
-u16
-XCBDisplayHeight(XCBDisplay *display, int screen)
+/* Checks the spot check sent by _xcb_atom_cache_load(), throwing away everything loaded if it doesnt match. */
+static void
+_xcb_atom_cache_verify(XCBDisplay *display, _XCBDisplayData *dd)
 {
-    /* Gets the screen structure */
-    return xcb_aux_get_screen(display, screen)->height_in_pixels;
+    _XCBAtomCache *cache = &dd->cache;
+    _XCBAtomTable *table = &dd->atoms;
+    const xcb_get_atom_name_cookie_t cookie = { .sequence = cache->verify };
+    xcb_get_atom_name_reply_t *reply;
+    XCBGenericError *err = NULL;
+    void **slot;
+    u8 ok = 0;
+
+    if(!cache->verifying)
+    {   return;
+    }
+    cache->verifying = 0;
+    reply = xcb_get_atom_name_reply(display, cookie, &err);
+    slot = _xcb_map_get(&table->atoms, cache->verify_atom);
+    if(reply && slot)
+    {
+        const _XCBAtomEntry *entry = &table->entries[(uintptr_t)*slot - 1];
+        ok = xcb_get_atom_name_name_length(reply) == (int)entry->len 
+            && !memcmp(xcb_get_atom_name_name(reply), entry->name, entry->len);
+    }
+    /* BadAtom here just means its a different server, not a real error */
+    free(reply);
+    free(err);
+    if(!ok)
+    {
+        _xcb_atom_wipe(table);
+        _xcb_atom_init(table);
+        munmap(cache->map, cache->map_len);
+        cache->map = NULL;
+        cache->map_len = 0;
+        /* rewrite the stale file even if nothing new is learned */
+        table->dirty = 1;
+    }
 }
-u8
-XCBDefaultDepth(XCBDisplay *display, int screen)
-{
-    /* Gets the screen structure */
-    return xcb_aux_get_screen(display, screen)->root_depth;
+
+static void
+_xcb_atom_cache_save(XCBDisplay *display, _XCBDisplayData *dd)
+{
+    _XCBAtomCache *cache = &dd->cache;
+    const _XCBAtomTable *table = &dd->atoms;
+    _XCBAtomCacheHeader header;
+    const _XCBAtomEntry *entry;
+    char *tmp = NULL;
+    u8 *buf = NULL;
+    size_t size;
+    size_t offset;
+    ssize_t written;
+    u32 i;
+    int fd;
+
+    if(cache->verifying)
+    {   
+        xcb_discard_reply(display, cache->verify);
+        cache->verifying = 0;
+    }
+    if(!cache->path || !table->dirty || xcb_connection_has_error(display))
+    {   goto CLEANUP;
+    }
+    header.magic = _XCB_ATOM_CACHE_MAGIC;
+    header.version = _XCB_ATOM_CACHE_VERSION;
+    header.key_len = cache->key_len;
+    header.count = 0;
+    size = sizeof(_XCBAtomCacheHeader) + _XCB_PAD4(cache->key_len);
+    for(i = 0; i < table->entries_len; ++i)
+    {
+        entry = &table->entries[i];
+        /* predefined atoms are never written, unresolved ones have nothing to write */
+        if(entry->atom > XCB_ATOM_WM_TRANSIENT_FOR)
+        {   
+            size += _XCB_PAD4(sizeof(u32) * 2 + entry->len + 1);
+            ++header.count;
+        }
+    }
+    if(!header.count)
+    {   
+        unlink(cache->path);
+        goto CLEANUP;
+    }
+    buf = calloc(1, size);
+    tmp = malloc(strlen(cache->path) + sizeof(".XXXXXX"));
+    if(!buf || !tmp)
+    {   goto CLEANUP;
+    }
+    memcpy(buf, &header, sizeof(_XCBAtomCacheHeader));
+    memcpy(buf + sizeof(_XCBAtomCacheHeader), cache->key, cache->key_len);
+    offset = sizeof(_XCBAtomCacheHeader) + _XCB_PAD4(cache->key_len);
+    for(i = 0; i < table->entries_len; ++i)
+    {
+        entry = &table->entries[i];
+        if(entry->atom > XCB_ATOM_WM_TRANSIENT_FOR)
+        {
+            memcpy(buf + offset, &entry->atom, sizeof(u32));
+            memcpy(buf + offset + sizeof(u32), &entry->len, sizeof(u32));
+            memcpy(buf + offset + sizeof(u32) * 2, entry->name, entry->len);
+            offset += _XCB_PAD4(sizeof(u32) * 2 + entry->len + 1);
+        }
+    }
+    /* write a temporary and rename it over, so readers only ever see a whole file */
+    strcpy(tmp, cache->path);
+    strcat(tmp, ".XXXXXX");
+    fd = mkstemp(tmp);
+    if(fd == -1)
+    {   goto CLEANUP;
+    }
+    for(offset = 0; offset < size; offset += written)
+    {
+        written = write(fd, buf + offset, size - offset);
+        if(written <= 0)
+        {   break;
+        }
+    }
+    if(close(fd) || offset != size || rename(tmp, cache->path))
+    {   unlink(tmp);
+    }
+CLEANUP:
+    free(tmp);
+    free(buf);
+    free(cache->path);
+    free(cache->key);
+    cache->path = NULL;
+    cache->key = NULL;
 }
 
-XCBCookie
-XCBSelectInput(XCBDisplay *display, XCBWindow window, u32 mask)
+/* Only after _xcb_atom_wipe(), names loaded from the file point into the map. */
+static void
+_xcb_atom_cache_unmap(_XCBDisplayData *dd)
 {
-#ifdef DBG
-    XCBCookie cookie = xcb_change_window_attributes_checked(display, window, XCB_CW_EVENT_MASK, &mask);
-    ck(display, cookie, _fn);
-    return cookie;
+    if(dd->cache.map)
+    {
+        munmap(dd->cache.map, dd->cache.map_len);
+        dd->cache.map = NULL;
+        dd->cache.map_len = 0;
+    }
+}
 #endif
 
-    return xcb_change_window_attributes(display, window, XCB_CW_EVENT_MASK, &mask);
+/* Event coalescing. */
+static int
+_xcb_coalesce_append(_XCBCoalescer *co, XCBGenericEvent *ev)
+{
+    if(co->len == co->cap)
+    {
+        const u32 cap = co->cap ? co->cap << 1 : 64;
+        XCBGenericEvent **events = realloc(co->events, cap * sizeof(XCBGenericEvent *));
+        if(!events)
+        {   return 0;
+        }
+        co->events = events;
+        co->cap = cap;
+    }
+    co->events[co->len++] = ev;
+    return 1;
 }
 
-XCBCookie
-XCBSetInputFocus(XCBDisplay *display, XCBWindow window, u8 revert_to, XCBTimestamp tim)
+/* Adds ev to the current batch, merging it with what is already there where possible.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (out of memory), ev is still owned by the caller.
+ */
+static int
+_xcb_coalesce_feed(_XCBCoalescer *co, XCBGenericEvent *ev)
 {
-#ifdef DBG
-    XCBCookie cookie = xcb_set_input_focus_checked(display, revert_to, window, tim);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
+    void **slot;
+    u32 i;
 
-    return xcb_set_input_focus(display, revert_to, window, tim);
+    ++co->stats.received;
+    /* synthetic events are someone elses business, never touch them */
+    if(ev->response_type & 0x80)
+    {   return _xcb_coalesce_append(co, ev);
+    }
+    switch(ev->response_type)
+    {
+        case XCB_MOTION_NOTIFY:
+        {
+            const XCBMotionNotifyEvent *motion = (XCBMotionNotifyEvent *)ev;
+            XCBMotionNotifyEvent *last = co->len > co->head ? (XCBMotionNotifyEvent *)co->events[co->len - 1] : NULL;
+            if(last && last->response_type == XCB_MOTION_NOTIFY && last->event == motion->event 
+            && last->child == motion->child && last->state == motion->state && last->same_screen == motion->same_screen)
+            {
+                free(last);
+                co->events[co->len - 1] = ev;
+                ++co->stats.motion;
+                return 1;
+            }
+            return _xcb_coalesce_append(co, ev);
+        }
+        case XCB_CONFIGURE_NOTIFY:
+        {
+            const XCBConfigureNotifyEvent *configure = (XCBConfigureNotifyEvent *)ev;
+            if(!_xcb_coalesce_append(co, ev))
+            {   return 0;
+            }
+            slot = _xcb_map_get(&co->configures, configure->window);
+            if(slot)
+            {
+                i = (uintptr_t)*slot - 1;
+                if(co->events[i] && ((XCBConfigureNotifyEvent *)co->events[i])->event == configure->event)
+                {
+                    free(co->events[i]);
+                    co->events[i] = NULL;
+                    ++co->stats.configure;
+                }
+            }
+            else
+            {   slot = _xcb_map_set(&co->configures, configure->window);
+            }
+            if(slot)
+            {   *slot = (void *)(uintptr_t)co->len;
+            }
+            return 1;
+        }
+        case XCB_DESTROY_NOTIFY:
+            /* the window may be reused after this, dont merge across it */
+            _xcb_map_del(&co->configures, ((XCBDestroyNotifyEvent *)ev)->window);
+            return _xcb_coalesce_append(co, ev);
+        case XCB_REPARENT_NOTIFY:
+            _xcb_map_del(&co->configures, ((XCBReparentNotifyEvent *)ev)->window);
+            return _xcb_coalesce_append(co, ev);
+        case XCB_EXPOSE:
+        {
+            XCBExposeEvent *expose = (XCBExposeEvent *)ev;
+            XCBExposeEvent *acc;
+            i32 x0;
+            i32 y0;
+            i32 x1;
+            i32 y1;
+            slot = _xcb_map_get(&co->exposes, expose->window);
+            if(!slot)
+            {
+                if(!expose->count)
+                {   return _xcb_coalesce_append(co, ev);
+                }
+                slot = _xcb_map_set(&co->exposes, expose->window);
+                if(!slot)
+                {   return _xcb_coalesce_append(co, ev);
+                }
+                *slot = ev;
+                return 1;
+            }
+            acc = *slot;
+            x0 = acc->x < expose->x ? acc->x : expose->x;
+            y0 = acc->y < expose->y ? acc->y : expose->y;
+            x1 = acc->x + acc->width > expose->x + expose->width ? acc->x + acc->width : expose->x + expose->width;
+            y1 = acc->y + acc->height > expose->y + expose->height ? acc->y + acc->height : expose->y + expose->height;
+            acc->x = x0;
+            acc->y = y0;
+            acc->width = x1 - x0;
+            acc->height = y1 - y0;
+            acc->count = expose->count;
+            free(ev);
+            ++co->stats.expose;
+            if(!acc->count)
+            {
+                _xcb_map_del(&co->exposes, acc->window);
+                if(!_xcb_coalesce_append(co, (XCBGenericEvent *)acc))
+                {   
+                    /* ev is already gone, hand back the union in its place */
+                    free(acc);
+                    return 1;
+                }
+            }
+            return 1;
+        }
+        default:
+            return _xcb_coalesce_append(co, ev);
+    }
 }
 
-XCBCookie
-XCBChangeWindowAttributes(XCBDisplay *display, XCBWindow window, u32 mask, XCBWindowAttributes *window_attributes)
+/* RETURN: Next reduced event, NULL if the batch is empty. */
+static XCBGenericEvent *
+_xcb_coalesce_pop(_XCBCoalescer *co)
 {
-#ifdef DBG
-    XCBCookie cookie = xcb_change_window_attributes_aux_checked(display, window, mask, window_attributes);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_change_window_attributes_aux(display, window, mask, window_attributes);
+    XCBGenericEvent *ev;
+    while(co->head < co->len)
+    {
+        ev = co->events[co->head++];
+        if(ev)
+        {   
+            ++co->stats.delivered;
+            return ev;
+        }
+    }
+    co->head = co->len = 0;
+    _xcb_map_clear(&co->configures);
+    return NULL;
 }
 
-u32
-XCBBlackPixel(XCBDisplay *display, int screen)
+static void
+_xcb_coalesce_wipe(_XCBCoalescer *co)
 {
-    const XCBScreen *scr = screen_of_display(display, screen);
-    if(scr)
-    {   return scr->black_pixel;
+    u32 i;
+    for(i = co->head; i < co->len; ++i)
+    {   free(co->events[i]);
     }
-    return 0; /* AKA NULL; AKA we didnt find a screen */
+    for(i = 0; i < co->exposes.cap; ++i)
+    {
+        if(co->exposes.keys[i] && co->exposes.keys[i] != _XCB_MAP_TOMB)
+        {   free(co->exposes.vals[i]);
+        }
+    }
+    free(co->events);
+    _xcb_map_wipe(&co->configures);
+    _xcb_map_wipe(&co->exposes);
 }
 
-u32
-XCBWhitePixel(XCBDisplay *display, int screen)
+/* Configure cache. */
+static _XCBGeometry *
+_xcb_cfg_get(_XCBConfigCache *cfg, XCBWindow window, int create)
 {
-    const XCBScreen *scr = screen_of_display(display, screen);
-    if(scr)
-    {   return scr->white_pixel;
+    void **slot = _xcb_map_get(&cfg->windows, window);
+    _XCBGeometry *geom;
+    if(slot)
+    {   return *slot;
     }
-    return 0; /* AKA NULL; AKA we didnt find a screen */
-}
-
-void
-XCBSync(XCBDisplay *display)
-{ 
-    /* "https://community.kde.org/Xcb"
-     * The xcb equivalent of XSync() is xcb_aux_sync(), which is in xcb-utils.
-     * The reason you won't find a sync function in libxcb is that there is no sync request in the X protocol. 
-     * Calling XSync() or xcb_aux_sync() is equivalent to calling XGetInputFocus() and throwing away the reply.
-     */
-    xcb_aux_sync(display);
+    if(!create)
+    {   return NULL;
+    }
+    geom = calloc(1, sizeof(_XCBGeometry));
+    if(!geom)
+    {   return NULL;
+    }
+    slot = _xcb_map_set(&cfg->windows, window);
+    if(!slot)
+    {
+        free(geom);
+        return NULL;
+    }
+    *slot = geom;
+    return geom;
 }
 
-void
-XCBSyncf(XCBDisplay *display)
+/* Merges the geometry part of a configure into what is pending for window.
+ *
+ * values:  1 per bit of mask, in bit order.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (out of memory), nothing was merged.
+ */
+static int
+_xcb_cfg_merge(_XCBConfigCache *cfg, XCBWindow window, u16 mask, const u32 *values)
 {
-    /* analagous to XSync(display, True) */
-    XCBSync(display);
-    XCBGenericEvent *ev = NULL;
-    while(((ev = XCBPollForQueuedEvent(display))))
-    {   
-        if(!ev->response_type)
-        {   _xcb_err_handler(display, (xcb_generic_error_t *)ev);
+    _XCBGeometry *geom = _xcb_cfg_get(cfg, window, 1);
+    void *p;
+    u32 i;
+    u8 bit;
+
+    if(!geom)
+    {   return 0;
+    }
+    if(!geom->listed && cfg->len == cfg->cap)
+    {
+        p = realloc(cfg->dirty, (cfg->cap ? cfg->cap << 1 : 64) * sizeof(XCBWindow));
+        if(!p)
+        {   return 0;
+        }
+        cfg->dirty = p;
+        cfg->cap = cfg->cap ? cfg->cap << 1 : 64;
+    }
+    /* a later bit can cancel an earlier one, listed keeps the window from going in twice */
+    for(i = 0; i < 5; ++i)
+    {
+        bit = 1 << i;
+        if(!(mask & bit))
+        {   continue;
+        }
+        /* setting it back to what the server already has cancels the change */
+        if((geom->known & bit) && geom->shadow[i] == *values)
+        {   geom->dirty &= ~bit;
         }
         else
-        {   free(ev);
+        {
+            if(!geom->listed)
+            {
+                cfg->dirty[cfg->len++] = window;
+                geom->listed = 1;
+            }
+            geom->pending[i] = *values;
+            geom->dirty |= bit;
         }
+        ++values;
     }
+    return 1;
 }
 
-
-
-
-XCBCookie
-XCBMoveWindow(XCBDisplay *display, XCBWindow window, i32 x, i32 y)
+/* Takes what the server says the geometry is, from a ConfigureNotify, and forgets destroyed windows. */
+static void
+_xcb_cfg_observe(_XCBConfigCache *cfg, const XCBGenericEvent *ev)
 {
-    const i32 values[4] = { x, y };
-    const u16 mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, values);
+    const XCBConfigureNotifyEvent *configure;
+    _XCBGeometry *geom;
+    void **slot;
+    switch(ev->response_type & 0x7f)
+    {
+        case XCB_CONFIGURE_NOTIFY:
+            configure = (const XCBConfigureNotifyEvent *)ev;
+            geom = _xcb_cfg_get(cfg, configure->window, 0);
+            /* generated before our last configure was processed, it says nothing about what that did */
+            if(geom && geom->inflight && (i16)(configure->sequence - geom->fence) < 0)
+            {   break;
+            }
+            if(geom)
+            {
+                geom->shadow[0] = configure->x;
+                geom->shadow[1] = configure->y;
+                geom->shadow[2] = configure->width;
+                geom->shadow[3] = configure->height;
+                geom->shadow[4] = configure->border_width;
+                geom->known = _XCB_GEOMETRY_MASK;
+                geom->inflight = 0;
+            }
+            break;
+        case XCB_DESTROY_NOTIFY:
+            /* anything pending is dropped with it, the flush skips windows it cant find */
+            slot = _xcb_map_get(&cfg->windows, ((const XCBDestroyNotifyEvent *)ev)->window);
+            if(slot)
+            {
+                free(*slot);
+                _xcb_map_del(&cfg->windows, ((const XCBDestroyNotifyEvent *)ev)->window);
+            }
+            break;
+    }
 }
 
-XCBCookie
-XCBMoveResizeWindow(XCBDisplay *display, XCBWindow window, i32 x, i32 y, u32 width, u32 height)
+static void
+_xcb_cfg_wipe(_XCBConfigCache *cfg)
 {
-    /* fucks up sometimes so this will do */
-    XCBMoveWindow(display, window, x, y);
-    return XCBResizeWindow(display, window, width, height);
+    u32 i;
+    for(i = 0; i < cfg->windows.cap; ++i)
+    {
+        if(cfg->windows.keys[i] && cfg->windows.keys[i] != _XCB_MAP_TOMB)
+        {   free(cfg->windows.vals[i]);
+        }
+    }
+    _xcb_map_wipe(&cfg->windows);
+    free(cfg->dirty);
+    cfg->dirty = NULL;
+    cfg->len = cfg->cap = 0;
 }
 
-XCBCookie
-XCBResizeWindow(XCBDisplay *display, XCBWindow window, u32 width, u32 height)
+/* Window mirror. */
+static XCBWindowState *
+_xcb_mirror_get(_XCBMirror *mirror, XCBWindow window)
 {
-    const u32 values[4] = { width, height };
-    const u32 mask = XCB_CONFIG_WINDOW_WIDTH|XCB_CONFIG_WINDOW_HEIGHT;
-
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-
-    return xcb_configure_window(display, window, mask, values);
+    void **slot = _xcb_map_get(&mirror->windows, window);
+    return slot ? *slot : NULL;
 }
 
-XCBCookie
-XCBRaiseWindow(XCBDisplay *display, XCBWindow window)
+/* RETURN: The (new) state of window, NULL on Failure. */
+static XCBWindowState *
+_xcb_mirror_add(_XCBMirror *mirror, XCBWindow window)
 {
-    const u32 values[1] = { XCB_STACK_MODE_ABOVE };
-    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    XCBWindowState *state = _xcb_mirror_get(mirror, window);
+    void **slot;
+    if(state)
+    {   return state;
+    }
+    state = calloc(1, sizeof(XCBWindowState));
+    if(!state)
+    {   return NULL;
+    }
+    slot = _xcb_map_set(&mirror->windows, window);
+    if(!slot)
+    {
+        free(state);
+        return NULL;
+    }
+    *slot = state;
+    return state;
 }
 
-XCBCookie
-XCBMapRaised(XCBDisplay *display, XCBWindow window)
+static void
+_xcb_mirror_del(_XCBMirror *mirror, XCBWindow window)
 {
-    xcb_map_window(display, window);
-#ifdef DBG
-    XCBCookie cookie = xcb_map_window_checked(display, window);
-    ck(display, cookie, _fn);
-    return XCBRaiseWindow(display, window);
-#endif
-    return XCBRaiseWindow(display, window);
+    void **slot = _xcb_map_get(&mirror->windows, window);
+    if(slot)
+    {
+        free(*slot);
+        _xcb_map_del(&mirror->windows, window);
+    }
 }
 
-XCBCookie
-XCBLowerWindow(XCBDisplay *display, XCBWindow window)
+/* Mapping or unmapping window changes whether its mapped descendants are viewable, the server sends nothing for those. */
+static void
+_xcb_mirror_cascade(_XCBMirror *mirror, XCBWindow window)
+{
+    XCBWindowState *state;
+    XCBWindowState *parent;
+    u32 depth;
+    u32 i;
+    u8 viewable;
+    u8 below;
+    for(i = 0; i < mirror->windows.cap; ++i)
+    {
+        if(!mirror->windows.keys[i] || mirror->windows.keys[i] == _XCB_MAP_TOMB)
+        {   continue;
+        }
+        state = mirror->windows.vals[i];
+        if(state->map_state == XCB_MAP_STATE_UNMAPPED)
+        {   continue;
+        }
+        /* viewable if every mirrored ancestor is mapped, an unmirrored one (root) is taken as viewable */
+        viewable = 1;
+        below = 0;
+        for(depth = 0; depth < mirror->windows.len && (parent = _xcb_mirror_get(mirror, state->parent)); ++depth)
+        {
+            below |= state->parent == window;
+            viewable &= parent->map_state != XCB_MAP_STATE_UNMAPPED;
+            state = parent;
+        }
+        if(below)
+        {
+            state = mirror->windows.vals[i];
+            state->map_state = viewable ? XCB_MAP_STATE_VIEWABLE : XCB_MAP_STATE_UNVIEWABLE;
+        }
+    }
+}
+
+static void
+_xcb_mirror_observe(_XCBMirror *mirror, const XCBGenericEvent *ev)
 {
-    const u32 values[1] = { XCB_STACK_MODE_BELOW };
-    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    XCBWindowState *state;
+    XCBWindowState *parent;
+    switch(ev->response_type & 0x7f)
+    {
+        case XCB_CREATE_NOTIFY:
+        {
+            const XCBCreateNotifyEvent *create = (const XCBCreateNotifyEvent *)ev;
+            if(_xcb_mirror_get(mirror, create->parent) && (state = _xcb_mirror_add(mirror, create->window)))
+            {
+                state->parent = create->parent;
+                state->x = create->x;
+                state->y = create->y;
+                state->width = create->width;
+                state->height = create->height;
+                state->border_width = create->border_width;
+                state->map_state = XCB_MAP_STATE_UNMAPPED;
+                state->override_redirect = create->override_redirect;
+            }
+            break;
+        }
+        case XCB_CONFIGURE_NOTIFY:
+        {
+            const XCBConfigureNotifyEvent *configure = (const XCBConfigureNotifyEvent *)ev;
+            if((state = _xcb_mirror_get(mirror, configure->window)))
+            {
+                state->x = configure->x;
+                state->y = configure->y;
+                state->width = configure->width;
+                state->height = configure->height;
+                state->border_width = configure->border_width;
+                state->override_redirect = configure->override_redirect;
+            }
+            break;
+        }
+        case XCB_MAP_NOTIFY:
+        {
+            const XCBMapNotifyEvent *map = (const XCBMapNotifyEvent *)ev;
+            if((state = _xcb_mirror_get(mirror, map->window)))
+            {
+                /* an unmirrored parent (root) is taken as viewable */
+                parent = _xcb_mirror_get(mirror, state->parent);
+                state->map_state = !parent || parent->map_state == XCB_MAP_STATE_VIEWABLE ? XCB_MAP_STATE_VIEWABLE : XCB_MAP_STATE_UNVIEWABLE;
+                state->override_redirect = map->override_redirect;
+                _xcb_mirror_cascade(mirror, map->window);
+            }
+            break;
+        }
+        case XCB_UNMAP_NOTIFY:
+        {
+            if((state = _xcb_mirror_get(mirror, ((const XCBUnMapNotifyEvent *)ev)->window)))
+            {
+                state->map_state = XCB_MAP_STATE_UNMAPPED;
+                _xcb_mirror_cascade(mirror, ((const XCBUnMapNotifyEvent *)ev)->window);
+            }
+            break;
+        }
+        case XCB_DESTROY_NOTIFY:
+            _xcb_mirror_del(mirror, ((const XCBDestroyNotifyEvent *)ev)->window);
+            break;
+        case XCB_REPARENT_NOTIFY:
+        {
+            const XCBReparentNotifyEvent *reparent = (const XCBReparentNotifyEvent *)ev;
+            if((state = _xcb_mirror_get(mirror, reparent->window)))
+            {
+                state->parent = reparent->parent;
+                state->x = reparent->x;
+                state->y = reparent->y;
+                state->override_redirect = reparent->override_redirect;
+            }
+            break;
+        }
+    }
 }
 
-XCBCookie
-XCBRaiseWindowIf(XCBDisplay *display, XCBWindow window)
+static void
+_xcb_mirror_wipe(_XCBMirror *mirror)
 {
-    const u32 values[1] = { XCB_STACK_MODE_TOP_IF };
-    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    u32 i;
+    for(i = 0; i < mirror->windows.cap; ++i)
+    {
+        if(mirror->windows.keys[i] && mirror->windows.keys[i] != _XCB_MAP_TOMB)
+        {   free(mirror->windows.vals[i]);
+        }
+    }
+    _xcb_map_wipe(&mirror->windows);
+    mirror->enabled = 0;
 }
 
-XCBCookie
-XCBLowerWindowIf(XCBDisplay *display, XCBWindow window)
+/* Everything that keeps client side state current from events goes through here. */
+/* Property cache. */
+static void
+_xcb_prop_drop(_XCBPropCache *cache, _XCBPropEntry **link)
 {
-    const u32 values[1] = { XCB_STACK_MODE_BOTTOM_IF };
-    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    _XCBPropEntry *entry = *link;
+    *link = entry->next;
+    if(entry->newer)
+    {   entry->newer->older = entry->older;
+    }
+    else
+    {   cache->newest = entry->older;
+    }
+    if(entry->older)
+    {   entry->older->newer = entry->newer;
+    }
+    else
+    {   cache->oldest = entry->newer;
+    }
+    cache->bytes -= sizeof(_XCBPropEntry) + entry->length;
+    /* the caller may still be reading its value */
+    if(entry == cache->lent)
+    {   cache->orphan = 1;
+    }
+    else
+    {   free(entry);
+    }
 }
 
-XCBCookie
-XCBRaiseLowerWindow(XCBDisplay *display, XCBWindow window)
+/* Ends the loan of the last value handed out, freeing it if nothing else holds it. */
+static void
+_xcb_prop_release(_XCBPropCache *cache)
 {
-    const u32 values[1] = { XCB_STACK_MODE_OPPOSITE };
-    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    if(cache->orphan)
+    {   free(cache->lent);
+    }
+    cache->lent = NULL;
+    cache->orphan = 0;
 }
 
-XCBCookie
-XCBSetWindowBorderWidth(XCBDisplay *display, XCBWindow window, u32 border_width)
+/* Drops property of window, every property of it if property is XCB_NONE. */
+static void
+_xcb_prop_forget(_XCBPropCache *cache, XCBWindow window, XCBAtom property)
 {
-    const u32 values[1] = { border_width };
-    const u32 mask = XCB_CONFIG_WINDOW_BORDER_WIDTH;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    void **slot = _xcb_map_get(&cache->windows, window);
+    _XCBPropEntry *head;
+    _XCBPropEntry **link = &head;
+    if(!slot)
+    {   return;
+    }
+    head = *slot;
+    while(*link)
+    {
+        if(property == XCB_NONE || (*link)->property == property)
+        {   _xcb_prop_drop(cache, link);
+        }
+        else
+        {   link = &(*link)->next;
+        }
+    }
+    if(head)
+    {   *slot = head;
+    }
+    else
+    {   _xcb_map_del(&cache->windows, window);
+    }
 }
 
-XCBCookie
-XCBSetSibling(XCBDisplay *display, XCBWindow window, XCBWindow sibling)
+/* Evicts the least recently used until size more bytes fit. */
+static void
+_xcb_prop_evict(_XCBPropCache *cache, size_t size)
 {
-    const u32 values[1] = { sibling };
-    const u32 mask = XCB_CONFIG_WINDOW_SIBLING;
-#ifdef DBG
-    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_configure_window(display, window, mask, &values);
+    void **slot;
+    _XCBPropEntry *head;
+    _XCBPropEntry **link;
+    XCBWindow window;
+    while(cache->oldest && cache->bytes + size > cache->max)
+    {
+        window = cache->oldest->window;
+        slot = _xcb_map_get(&cache->windows, window);
+        head = *slot;
+        link = &head;
+        while(*link != cache->oldest)
+        {   link = &(*link)->next;
+        }
+        _xcb_prop_drop(cache, link);
+        if(head)
+        {   *slot = head;
+        }
+        else
+        {   _xcb_map_del(&cache->windows, window);
+        }
+    }
 }
 
-XCBCookie
-XCBGetWindowAttributesCookie(XCBDisplay *display, XCBWindow window)
+static void
+_xcb_prop_touch(_XCBPropCache *cache, _XCBPropEntry *entry)
 {
-    const xcb_get_window_attributes_cookie_t cookie = xcb_get_window_attributes(display, window);
-    return (XCBCookie) { .sequence = cookie.sequence };
+    if(cache->newest == entry)
+    {   return;
+    }
+    /* entry isnt the newest so it has a newer one */
+    entry->newer->older = entry->older;
+    if(entry->older)
+    {   entry->older->newer = entry->newer;
+    }
+    else
+    {   cache->oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    cache->newest->newer = entry;
+    cache->newest = entry;
 }
 
-XCBGetWindowAttributes *
-XCBGetWindowAttributesReply(XCBDisplay *display, XCBCookie cookie)
+static void
+_xcb_prop_observe(_XCBPropCache *cache, const XCBGenericEvent *ev)
 {
-    XCBGenericError *err = NULL;
-    XCBGetWindowAttributes *reply = NULL;
-    const xcb_get_window_attributes_cookie_t cookie1 = { .sequence = cookie.sequence };
-    reply = xcb_get_window_attributes_reply(display, cookie1, &err);
-    if(err)
+    switch(ev->response_type & 0x7f)
     {
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
+        case XCB_PROPERTY_NOTIFY:
+        {
+            const XCBPropertyNotifyEvent *notify = (const XCBPropertyNotifyEvent *)ev;
+            _xcb_prop_forget(cache, notify->window, notify->atom);
+            break;
         }
-        return NULL;
+        case XCB_DESTROY_NOTIFY:
+            _xcb_prop_forget(cache, ((const XCBDestroyNotifyEvent *)ev)->window, XCB_NONE);
+            break;
     }
-    return reply;
 }
 
-XCBCookie
-XCBGetWindowGeometryCookie(XCBDisplay *display, XCBWindow window)
+static void
+_xcb_prop_wipe(_XCBPropCache *cache)
 {
-    const xcb_get_geometry_cookie_t cookie = xcb_get_geometry(display, window);
-    return (XCBCookie) { .sequence = cookie.sequence };
+    _XCBPropEntry *entry;
+    while((entry = cache->oldest))
+    {
+        cache->oldest = entry->newer;
+        if(entry != cache->lent)
+        {   free(entry);
+        }
+    }
+    _xcb_map_wipe(&cache->windows);
+    cache->orphan = !!cache->lent;
+    cache->newest = NULL;
+    cache->bytes = 0;
+    cache->enabled = 0;
 }
 
-XCBGeometry *
-XCBGetWindowGeometryReply(XCBDisplay *display, XCBCookie cookie)
+/* Keymap. */
+static void
+_xcb_keymap_observe(_XCBKeymap *km, const XCBGenericEvent *ev)
 {
-    XCBGenericError *err = NULL;
-    XCBGeometry *reply = NULL;
-    const xcb_get_geometry_cookie_t cookie1 = { .sequence = cookie.sequence };
-    reply = xcb_get_geometry_reply(display, cookie1, &err);
-    if(err)
+    const XCBMappingNotifyEvent *mapping = (const XCBMappingNotifyEvent *)ev;
+    u8 last;
+    if((ev->response_type & 0x7f) != XCB_MAPPING_NOTIFY || mapping->request != XCB_MAPPING_KEYBOARD || !mapping->count)
+    {   return;
+    }
+    last = mapping->first_keycode + mapping->count - 1;
+    if(!km->dirty)
     {   
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
-        }
-        return NULL;
+        km->first = mapping->first_keycode;
+        km->last = last;
+        km->dirty = 1;
+        return;
+    }
+    if(mapping->first_keycode < km->first)
+    {   km->first = mapping->first_keycode;
+    }
+    if(last > km->last)
+    {   km->last = last;
     }
-    return reply;
 }
 
+static void
+_xcb_modmap_observe(_XCBModmap *mm, const XCBGenericEvent *ev)
+{
+    const XCBMappingNotifyEvent *mapping = (const XCBMappingNotifyEvent *)ev;
+    if((ev->response_type & 0x7f) != XCB_MAPPING_NOTIFY)
+    {   return;
+    }
+    if(mapping->request == XCB_MAPPING_MODIFIER)
+    {   mm->dirty = 1;
+    }
+    else if(mapping->request == XCB_MAPPING_KEYBOARD)
+    {   mm->stale = 1;
+    }
+}
 
-XCBCookie
-XCBGetGeometryCookie(
-        XCBDisplay *display,
-        XCBWindow window)
+/* Monitors. */
+static void
+_xcb_monitors_observe(_XCBMonitorCache *mc, const XCBGenericEvent *ev)
 {
-    return XCBGetWindowGeometryCookie(display, window);
+    const u8 type = ev->response_type & 0x7f;
+    if(mc->first_event && (type == mc->first_event + XCB_RANDR_SCREEN_CHANGE_NOTIFY || type == mc->first_event + XCB_RANDR_NOTIFY))
+    {   mc->dirty = 1;
+    }
+    else if(type == XCB_CONFIGURE_NOTIFY && ((const XCBConfigureNotifyEvent *)ev)->window == mc->root)
+    {   mc->dirty = 1;
+    }
 }
 
-XCBGeometry *
-XCBGetGeometryReply(
-        XCBDisplay *display,
-        XCBCookie cookie
-        )
+static void
+_xcb_monitors_wipe(_XCBMonitorCache *mc)
 {
-    return XCBGetWindowGeometryReply(display, cookie);
+    free(mc->current);
+    memset(mc, 0, sizeof(_XCBMonitorCache));
 }
 
+static void
+_xcb_keymap_wipe(_XCBKeymap *km)
+{
+    free(km->syms);
+    free(km->next);
+    _xcb_map_wipe(&km->index);
+    memset(km, 0, sizeof(_XCBKeymap));
+}
 
-XCBCookie
-XCBInternAtomCookie(XCBDisplay *display, const char *name, int only_if_exists)
+static void
+_xcb_observe(_XCBDisplayData *dd, const XCBGenericEvent *ev)
 {
-    const xcb_intern_atom_cookie_t cookie = xcb_intern_atom(display, only_if_exists, strlen(name), name);
-    return (XCBCookie) { .sequence = cookie.sequence };
+    if(dd->configs.enabled)
+    {   _xcb_cfg_observe(&dd->configs, ev);
+    }
+    if(dd->mirror.enabled)
+    {   _xcb_mirror_observe(&dd->mirror, ev);
+    }
+    if(dd->props.enabled)
+    {   _xcb_prop_observe(&dd->props, ev);
+    }
+    if(dd->keymap.loaded)
+    {   _xcb_keymap_observe(&dd->keymap, ev);
+    }
+    if(dd->modmap.loaded)
+    {   _xcb_modmap_observe(&dd->modmap, ev);
+    }
+    if(dd->monitors.enabled)
+    {   _xcb_monitors_observe(&dd->monitors, ev);
+    }
 }
 
-XCBAtom
-XCBInternAtomReply(XCBDisplay *display, XCBCookie cookie)
+/* RETURN: 1 if events need to go through _xcb_observe(). */
+static int
+_xcb_observing(const _XCBDisplayData *dd)
 {
-    XCBGenericError *err = NULL;
-    const xcb_intern_atom_cookie_t cookie1 = { .sequence = cookie.sequence };
-    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(display, cookie1, &err);
-    if(err)
+    return dd && (dd->configs.enabled || dd->mirror.enabled || dd->props.enabled || dd->keymap.loaded || dd->modmap.loaded || dd->monitors.enabled);
+}
+
+/* Reader thread. */
+static void
+_xcb_eventfd_signal(int fd)
+{
+    const u64 one = 1;
+    /* only fails when the counter would overflow, it is readable either way */
+    (void)!write(fd, &one, sizeof(one));
+}
+
+static void
+_xcb_eventfd_clear(int fd)
+{
+    u64 count;
+    (void)!read(fd, &count, sizeof(count));
+}
+
+static void *
+_xcb_reader_main(void *arg)
+{
+    _XCBReader *rd = arg;
+    struct pollfd pfd = { .fd = rd->space, .events = POLLIN };
+    XCBGenericEvent *ev;
+    u32 head;
+
+    while((ev = xcb_wait_for_event(rd->display)))
     {
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
+        if((ev->response_type & 0x7f) == XCB_CLIENT_MESSAGE && ((XCBClientMessageEvent *)ev)->window == rd->window)
+        {
+            free(ev);
+            break;
+        }
+        head = atomic_load_explicit(&rd->head, memory_order_relaxed);
+        while(head - atomic_load(&rd->tail) > rd->mask)
+        {
+            /* full, clear before checking again so a pop after this still wakes us */
+            _xcb_eventfd_clear(rd->space);
+            if(head - atomic_load(&rd->tail) > rd->mask)
+            {   poll(&pfd, 1, -1);
+            }
+        }
+        rd->ring[head & rd->mask] = ev;
+        atomic_store(&rd->head, head + 1);
+        /* the consumer only sleeps on an empty ring */
+        if(atomic_load(&rd->tail) == head)
+        {   _xcb_eventfd_signal(rd->ready);
         }
-        return 0;
     }
-    const xcb_atom_t atom = reply->atom;
-    free(reply);
-    return atom;
+    atomic_store(&rd->done, 1);
+    _xcb_eventfd_signal(rd->ready);
+    return NULL;
 }
 
-XCBCookie
-XCBGetTransientForHintCookie(
-        XCBDisplay *display, 
-        XCBWindow win)
+static XCBGenericEvent *
+_xcb_reader_pop(_XCBReader *rd)
 {
-    xcb_get_property_cookie_t cookie = xcb_icccm_get_wm_transient_for(display, win);
-    return (XCBCookie) { .sequence = cookie.sequence };
+    XCBGenericEvent *ev;
+    u32 tail;
+    if(rd->stash_head < rd->stash_len)
+    {   return rd->stash[rd->stash_head++];
+    }
+    tail = atomic_load_explicit(&rd->tail, memory_order_relaxed);
+    if(atomic_load(&rd->head) == tail)
+    {   return NULL;
+    }
+    ev = rd->ring[tail & rd->mask];
+    atomic_store(&rd->tail, tail + 1);
+    /* the reader only sleeps on a full ring */
+    if(atomic_load(&rd->head) - tail > rd->mask)
+    {   _xcb_eventfd_signal(rd->space);
+    }
+    return ev;
 }
 
-u8
-XCBGetTransientForHintReply(
-        XCBDisplay *display,
-        XCBCookie cookie,
-        XCBWindow *win
-        )
+/* Waits for the reader to exit, moving what it reads meanwhile to the stash so it cannot get stuck on a full ring. */
+static void
+_xcb_reader_stop(XCBDisplay *display, _XCBReader *rd)
 {
-    XCBGenericError *err = NULL;
-    xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
-    const u8 status = xcb_icccm_get_wm_transient_for_reply(display, cookie1, win, &err);
+    struct pollfd pfd = { .fd = rd->ready, .events = POLLIN };
+    XCBClientMessageEvent msg;
+    XCBGenericEvent *ev;
+    void *p;
+    u32 tail;
 
-    if(err)
-    {   _xcb_err_handler(display, err);
-        return 0;
+    if(rd->joined)
+    {   return;
+    }
+    if(!atomic_exchange(&rd->stopping, 1) && !atomic_load(&rd->done))
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.response_type = XCB_CLIENT_MESSAGE;
+        msg.format = 32;
+        msg.window = rd->window;
+        /* no event mask, goes to us as the creator of window */
+        xcb_send_event(display, 0, rd->window, XCB_EVENT_MASK_NO_EVENT, (const char *)&msg);
+        xcb_flush(display);
+    }
+    while(!atomic_load(&rd->done))
+    {
+        _xcb_eventfd_clear(rd->ready);
+        tail = atomic_load_explicit(&rd->tail, memory_order_relaxed);
+        while(tail != atomic_load(&rd->head))
+        {
+            if(rd->stash_len == rd->stash_cap)
+            {
+                p = realloc(rd->stash, (rd->stash_cap ? rd->stash_cap << 1 : 64) * sizeof(XCBGenericEvent *));
+                if(!p)
+                {   break;
+                }
+                rd->stash = p;
+                rd->stash_cap = rd->stash_cap ? rd->stash_cap << 1 : 64;
+            }
+            ev = rd->ring[tail & rd->mask];
+            atomic_store(&rd->tail, ++tail);
+            rd->stash[rd->stash_len++] = ev;
+            _xcb_eventfd_signal(rd->space);
+        }
+        if(!atomic_load(&rd->done))
+        {   poll(&pfd, 1, 100);
+        }
+    }
+    pthread_join(rd->thread, NULL);
+    rd->joined = 1;
+    if(!xcb_connection_has_error(display))
+    {   xcb_destroy_window(display, rd->window);
     }
-    return status;
 }
 
-XCBCookie
-XCBGetPropertyCookie(
-        XCBDisplay *display,
-        XCBWindow window,
-        XCBAtom property,
-        uint32_t long_offset,
-        uint32_t long_length,
-        uint8_t _delete,
-        XCBAtom req_type
-        )
+static void
+_xcb_reader_free(XCBDisplay *display, _XCBDisplayData *dd)
 {
-    const xcb_get_property_cookie_t cookie = xcb_get_property(display, _delete, window, property, req_type, long_offset, long_length);
-    return (XCBCookie) {.sequence = cookie.sequence };
+    _XCBReader *rd = dd->reader;
+    XCBGenericEvent *ev;
+    _xcb_reader_stop(display, rd);
+    while((ev = _xcb_reader_pop(rd)))
+    {   free(ev);
+    }
+    close(rd->ready);
+    close(rd->space);
+    free(rd->stash);
+    free(rd->ring);
+    free(rd);
+    dd->reader = NULL;
 }
 
-XCBCookie 
-XCBGetWindowPropertyCookie(
-        XCBDisplay *display,
-        XCBWindow window,
-        XCBAtom property,
-        uint32_t long_offset,
-        uint32_t long_length,
-        uint8_t _delete,
-        XCBAtom req_type
-        )
+/* Every pop outside of freeing goes through here, once the reader has exited and everything it read is handed out it is freed.
+ *
+ * RETURN: Next event from the reader thread, NULL if there is none (yet), dd->reader is NULL if it was freed.
+ */
+static XCBGenericEvent *
+_xcb_reader_take(XCBDisplay *display, _XCBDisplayData *dd)
 {
-    const xcb_get_property_cookie_t cookie = xcb_get_property(display, _delete, window, property, req_type, long_offset, long_length);
-    return (XCBCookie) {.sequence = cookie.sequence };
+    XCBGenericEvent *ev = _xcb_reader_pop(dd->reader);
+    /* done is set after its last push, so a pop after seeing it finds everything */
+    if(!ev && atomic_load(&dd->reader->done) && !(ev = _xcb_reader_pop(dd->reader)))
+    {   _xcb_reader_free(display, dd);
+    }
+    return ev;
 }
 
-XCBWindowProperty *
-XCBGetWindowPropertyReply(
-        XCBDisplay *display,
-        XCBCookie cookie
-        )
+/* RETURN: Next event from the reader thread, reading the connection directly again once it is done and drained. */
+static XCBGenericEvent *
+_xcb_reader_next(XCBDisplay *display, _XCBDisplayData *dd, int block)
 {
-    XCBGenericError *err = NULL;
-    const xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
-    xcb_get_property_reply_t *reply = xcb_get_property_reply(display, cookie1, &err);
-    if(err)
+    _XCBReader *rd = dd->reader;
+    struct pollfd pfd = { .fd = rd->ready, .events = POLLIN };
+    XCBGenericEvent *ev;
+
+    while(!(ev = _xcb_reader_take(display, dd)))
     {
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
+        if(!dd->reader)
+        {   return block ? xcb_wait_for_event(display) : xcb_poll_for_event(display);
+        }
+        if(!block)
+        {   return NULL;
+        }
+        /* clear first, a push after this finds the ring empty and signals again */
+        _xcb_eventfd_clear(rd->ready);
+        if(atomic_load(&rd->head) == atomic_load(&rd->tail) && !atomic_load(&rd->done))
+        {   poll(&pfd, 1, -1);
         }
-        return NULL;
     }
-    return reply;
+    return ev;
 }
 
-void *
-XCBGetWindowPropertyValue(XCBWindowProperty *reply)
+/* Every event read goes through here exactly once, in the order it came in, before coalescing can drop or hold it back. */
+static XCBGenericEvent *
+_xcb_arrived(_XCBDisplayData *dd, XCBGenericEvent *ev)
 {
-    return xcb_get_property_value(reply);
+    if(ev && _xcb_observing(dd))
+    {   _xcb_observe(dd, ev);
+    }
+    return ev;
 }
 
-u32
-XCBGetWindowPropertyValueSize(XCBWindowProperty *reply)
+/* Defined with the error handler, errors of unchecked requests read as events go in the same ring. */
+static int _xcb_err_ring_take(_XCBErrorRing *ring, const XCBGenericError *err);
+
+/* Moves ev into the error ring when it is an error and the ring is on, see XCBSetErrorRing().
+ *
+ * RETURN: 1 if ev was taken (and freed), the caller reads the next one instead.
+ * RETURN: 0 otherwise.
+ */
+static int
+_xcb_err_routed(_XCBDisplayData *dd, XCBGenericEvent *ev)
 {
-    return xcb_get_property_value_length(reply);
+    if(!ev || ev->response_type || !dd || !dd->errors.enabled)
+    {   return 0;
+    }
+    _xcb_err_ring_take(&dd->errors, (XCBGenericError *)ev);
+    free(ev);
+    return 1;
 }
 
-u32
-XCBGetWindowPropertyValueLength(XCBWindowProperty *reply, size_t size)
+/* RETURN: The event a mirror check read ahead, it went through _xcb_arrived() when it was read. */
+static XCBGenericEvent *
+_xcb_ahead(_XCBDisplayData *dd)
 {
-    return xcb_get_property_value_length(reply) / (size);
+    XCBGenericEvent *ev = dd ? dd->ahead : NULL;
+    if(ev)
+    {   dd->ahead = NULL;
+    }
+    return ev;
 }
 
-XCBWindowProperty *
-XCBGetPropertyReply(
-        XCBDisplay *display,
-        XCBCookie cookie
-        )
+/* xcb_poll_for_queued_event(), unless the reader thread owns the queue. */
+static XCBGenericEvent *
+_xcb_queued_event(XCBDisplay *display, _XCBDisplayData *dd)
 {
-    XCBGenericError *err = NULL;
-    const xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
-    xcb_get_property_reply_t *reply = xcb_get_property_reply(display, cookie1, &err);
-    if(err)
+    XCBGenericEvent *ev = _xcb_ahead(dd);
+    if(ev)
+    {   return ev;
+    }
+    do
     {
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
+        ev = NULL;
+        if(dd && dd->reader)
+        {   ev = _xcb_reader_take(display, dd);
         }
-        return NULL;
-    }
-    return reply;
+        if(!ev && (!dd || !dd->reader))
+        {   ev = xcb_poll_for_queued_event(display);
+        }
+        ev = _xcb_arrived(dd, ev);
+    } while(_xcb_err_routed(dd, ev));
+    return ev;
 }
 
-void *
-XCBGetPropertyValue(XCBWindowProperty *reply)
+/* Screens. */
+static void
+_xcb_screens_wipe(_XCBScreenTable *st)
 {
-    return xcb_get_property_value(reply);
+    free(st->screens);
+    _xcb_map_wipe(&st->index);
+    memset(st, 0, sizeof(_XCBScreenTable));
 }
 
-u32
-XCBGetPropertyValueSize(
-        XCBWindowProperty *reply
-        )
+static void
+_xcb_screens_init(_XCBScreenTable *st, XCBDisplay *display)
 {
-    return xcb_get_property_value_length(reply); 
+    const XCBSetup *setup = xcb_get_setup(display);
+    xcb_screen_iterator_t screens;
+    xcb_depth_iterator_t depths;
+    xcb_visualtype_iterator_t visuals;
+    _XCBScreenInfo *info;
+    _XCBVisualInfo *visual;
+    void **slot;
+    u32 count = 0;
+    u32 nvisuals = 0;
+
+    if(!setup)
+    {   return;
+    }
+    for(screens = xcb_setup_roots_iterator(setup); screens.rem; xcb_screen_next(&screens))
+    {
+        ++count;
+        for(depths = xcb_screen_allowed_depths_iterator(screens.data); depths.rem; xcb_depth_next(&depths))
+        {   nvisuals += depths.data->visuals_len;
+        }
+    }
+    if(!count)
+    {   return;
+    }
+    st->screens = malloc(count * sizeof(_XCBScreenInfo) + nvisuals * sizeof(_XCBVisualInfo));
+    if(!st->screens)
+    {   return;
+    }
+    st->visuals = (_XCBVisualInfo *)(st->screens + count);
+    info = st->screens;
+    visual = st->visuals;
+    for(screens = xcb_setup_roots_iterator(setup); screens.rem; xcb_screen_next(&screens), ++info)
+    {
+        info->screen = screens.data;
+        info->root = screens.data->root;
+        info->root_visual = screens.data->root_visual;
+        info->black_pixel = screens.data->black_pixel;
+        info->white_pixel = screens.data->white_pixel;
+        info->width = screens.data->width_in_pixels;
+        info->height = screens.data->height_in_pixels;
+        info->depth = screens.data->root_depth;
+        for(depths = xcb_screen_allowed_depths_iterator(screens.data); depths.rem; xcb_depth_next(&depths))
+        {
+            for(visuals = xcb_depth_visuals_iterator(depths.data); visuals.rem; xcb_visualtype_next(&visuals), ++visual)
+            {
+                visual->visual = visuals.data;
+                visual->depth = depths.data->depth;
+                visual->screen = info - st->screens;
+                /* first one wins, same as a scan would */
+                slot = _xcb_map_set(&st->index, visuals.data->visual_id);
+                if(slot && !*slot)
+                {   *slot = visual;
+                }
+            }
+        }
+    }
+    st->count = count;
+    st->nvisuals = nvisuals;
 }
 
-u32
-XCBGetPropertyValueLength(
-        XCBWindowProperty *reply,
-        size_t size
-        )
+static _XCBDisplayData *
+_xcb_dpy(XCBDisplay *display)
 {
-    return xcb_get_property_value_length(reply) / size;
-}
+    _XCBDisplayData *prev = NULL;
+    _XCBDisplayData *dd;
 
+    pthread_mutexattr_t attr;
 
-XCBPixmap
-XCBCreatePixmap(XCBDisplay *display, XCBWindow root, u16 width, u16 height, u8 depth)
-{
-    const XCBPixmap id = xcb_generate_id(display);
+    if(!display)
+    {   return NULL;
+    }
+    /* the list is shared by every display, so this is taken even when display itself is only used by 1 thread */
+    pthread_mutex_lock(&_dpys_lock);
+    for(dd = _dpys; dd; prev = dd, dd = dd->next)
+    {
+        if(dd->display == display)
+        {
+            if(prev)
+            {
+                prev->next = dd->next;
+                dd->next = _dpys;
+                _dpys = dd;
+            }
+            pthread_mutex_unlock(&_dpys_lock);
+            return dd;
+        }
+    }
+    dd = calloc(1, sizeof(_XCBDisplayData));
+    if(dd)
+    {
+        dd->display = display;
+        dd->id = ++_dpys_id;
+        _xcb_atom_init(&dd->atoms);
+        _xcb_screens_init(&dd->screens, display);
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&dd->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        pthread_mutex_init(&dd->stage, NULL);
+        pthread_mutex_init(&dd->errors.store, NULL);
+        pthread_cond_init(&dd->staged, NULL);
+        dd->next = _dpys;
+        _dpys = dd;
+    }
+    pthread_mutex_unlock(&_dpys_lock);
+    return dd;
+}
 
-#ifdef DBG
-    XCBCookie cookie = xcb_create_pixmap(display, depth, id, root, width, height);
-    ck(display, cookie, _fn);
-    return id;
+static void
+_xcb_dpy_free(XCBDisplay *display)
+{
+    _XCBDisplayData **link;
+    _XCBDisplayData *dd;
+    pthread_mutex_lock(&_dpys_lock);
+    for(link = &_dpys; (dd = *link); link = &dd->next)
+    {
+        if(dd->display == display)
+        {
+            *link = dd->next;
+            break;
+        }
+    }
+    if(dd)
+    {   atomic_fetch_add(&_dpys_freed, 1);
+    }
+    pthread_mutex_unlock(&_dpys_lock);
+    if(!dd)
+    {   return;
+    }
+    if(dd->reader)
+    {   _xcb_reader_free(display, dd);
+    }
+    free(dd->checks.checks);
+    _xcb_coalesce_wipe(&dd->coalesce);
+    free(dd->payloads.data);
+    free(dd->payloads.index);
+    free(dd->ahead);
+    _xcb_cfg_wipe(&dd->configs);
+    _xcb_mirror_wipe(&dd->mirror);
+    _xcb_prop_wipe(&dd->props);
+    _xcb_prop_release(&dd->props);
+    _xcb_keymap_wipe(&dd->keymap);
+    _xcb_screens_wipe(&dd->screens);
+    _xcb_monitors_wipe(&dd->monitors);
+#ifdef ATOM_CACHE
+    _xcb_atom_cache_save(display, dd);
 #endif
-
-    xcb_create_pixmap(display, depth, id, root, width, height);
-    return id;
+    _xcb_atom_wipe(&dd->atoms);
+#ifdef ATOM_CACHE
+    _xcb_atom_cache_unmap(dd);
+#endif
+    for(; dd->replies.head < dd->replies.len; ++dd->replies.head)
+    {   xcb_discard_reply64(display, dd->replies.items[dd->replies.head].sequence);
+    }
+    free(dd->replies.items);
+    pthread_mutex_destroy(&dd->lock);
+    pthread_mutex_destroy(&dd->stage);
+    pthread_cond_destroy(&dd->staged);
+    pthread_mutex_destroy(&dd->errors.store);
+    free(dd);
 }
 
-/* Cursors */
-
-XCBCursor
-XCBCreateFontCursor(XCBDisplay *display, int shape)
+/* RETURN: The atom table of display, after checking anything loaded from the cache file.
+ * RETURN: NULL on Failure.
+ */
+static _XCBAtomTable *
+_xcb_dpy_atoms(XCBDisplay *display)
 {
-    /* FORMAT IN RGB: (AKA RED GREEN BLUE) */
-    /* fg = foreground; bg = background */
-    const u16 fgred = 0;
-    const u16 fggreen = 0;
-    const u16 fgblue = 0;
-
-    const u16 bgred = 0;
-    const u16 bggreen = 0;
-    const u16 bgblue = 0;
-
-    const xcb_font_t font = xcb_generate_id(display);
-    const u8 strlenofcursor = 6;    /* X only reads data for those 6 chars so no need for +1 for the \0 character */
-
-    xcb_open_font(display, font, strlenofcursor, "cursor");
-
-    const xcb_cursor_t id = xcb_generate_id(display);
-
-
-#ifdef DBG
-    XCBCookie cookie = xcb_create_glyph_cursor_checked(display, id, font, font, shape, shape + 1,
-                            fgred, fggreen, fgblue,
-                            bgred, bggreen, bgblue);
-    ck(display, cookie, _fn);
-    return id;
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd)
+    {   return NULL;
+    }
+#ifdef ATOM_CACHE
+    _xcb_atom_cache_verify(display, dd);
 #endif
-
-    xcb_create_glyph_cursor(display, id, font, font, shape, shape + 1,
-                            fgred, fggreen, fgblue,
-                            bgred, bggreen, bgblue);
-    return id;
+    return &dd->atoms;
 }
 
-XCBCookie
-XCBFreeCursor(XCBDisplay *display, XCBCursor cursor)
+static u64
+_xcb_time_ms(void)
 {
-    return xcb_free_cursor(display, cursor);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-XCBCookie
-XCBDefineCursor(XCBDisplay *display, XCBWindow window, XCBCursor id)
-{   
-    const u32 mask = XCB_CW_CURSOR;
-#if DBG
-    XCBCookie cookie = xcb_change_window_attributes_checked(display, window, mask, &id);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
-    return xcb_change_window_attributes(display, window, mask, &id);
+static u64
+_xcb_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
-XCBCookie
-XCBOpenFont(XCBDisplay *display, XCBFont id, const char *name)
+/* RETURN: 1 if err was taken (rate limited or stored in the ring), nothing else should see it.
+ * RETURN: 0 if err should go to the error handler as usual.
+ */
+static int
+_xcb_err_ring_take(_XCBErrorRing *ring, const XCBGenericError *err)
 {
-    const u16 len = strlen(name);
+    u32 head;
+    u32 tail;
+    u64 now;
+    int ret = 1;
 
-#if DBG
-    XCBCookie cookie = xcb_open_font_checked(display, id, len, name);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
+    pthread_mutex_lock(&ring->store);
+    if(ring->limits[err->error_code])
+    {
+        now = _xcb_time_ms();
+        if(now - ring->window >= 1000)
+        {
+            memset(ring->counts, 0, sizeof(ring->counts));
+            ring->window = now;
+        }
+        if(ring->counts[err->error_code] >= ring->limits[err->error_code])
+        {   
+            ++ring->suppressed;
+            goto CLEANUP;
+        }
+        ++ring->counts[err->error_code];
+    }
+    if(!ring->enabled)
+    {   
+        ret = 0;
+        goto CLEANUP;
+    }
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(head - tail == _XCB_ERROR_RING)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        goto CLEANUP;
+    }
+    ring->errors[head & (_XCB_ERROR_RING - 1)] = *err;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+CLEANUP:
+    pthread_mutex_unlock(&ring->store);
+    return ret;
+}
+
+#ifdef DBG
+static void
+jmpck(XCBDisplay *d, XCBGenericError *err)
+{
+    fprintf(stderr, "%s %s\n", XCBErrorCodeText(err->error_code), XCBErrorMajorCodeText(err->major_code));
+    fprintf(stderr, 
+            "error_code:    [%d]\n"
+            "major_code:    [%d]\n"
+            "minor_code:    [%d]\n"
+            "sequence:      [%d]\n"
+            "response_type: [%d]\n"
+            "resource_id:   [%d]\n"
+            "full_sequence: [%d]\n"
+              ,
+           err->error_code, err->major_code, err->minor_code, 
+           err->sequence, err->response_type, err->resource_id, 
+           err->full_sequence);
 
-    return xcb_open_font(display, id, len, name);
 }
 
-XCBCookie
-XCBCloseFont(XCBDisplay *display, XCBFont id)
+static void
+ck_report(XCBDisplay *d, XCBGenericError *err, const char *func, u32 ms)
 {
-    return xcb_close_font(display, id);
+    jmpck(d, err);
+    fprintf(stderr, "Occured at: %s (%u ms ago)\n", func, ms);
+    /* to retain some functionaly we keep these for XCBDrainErrors(), this used to resend them to the root window
+     * which cost a extra request per error.
+     */
+    _XCBDisplayData *dd = _xcb_dpy(d);
+    if(dd)
+    {   _xcb_err_ring_take(&dd->errors, err);
+    }
+    free(err);
+    XCBBreakPoint();
 }
 
+#ifdef DEFERRED_CK
+/* Reports every check thats completed so far, stops at the first one still in flight. */
+static void
+ck_poll(XCBDisplay *d, _XCBCheckTable *table)
+{
+    _XCBCheck *check;
+    XCBGenericError *err;
+    void *reply;
 
-/* text property textproperty */
+    while(table->tail != table->head)
+    {
+        check = &table->checks[table->tail & (_XCB_CHECK_TABLE - 1)];
+        reply = NULL;
+        err = NULL;
+        if(!xcb_poll_for_reply(d, check->sequence, &reply, &err))
+        {   break;
+        }
+        ++table->tail;
+        free(reply);
+        if(err)
+        {   ck_report(d, err, check->func, (u32)_xcb_time_ms() - check->time);
+        }
+    }
+}
 
-XCBCookie
-XCBGetTextPropertyCookie(XCBDisplay *display, XCBWindow window, XCBAtom property)
+/* Reports everything left, blocking until the server has caught up. */
+static void
+ck_flush(XCBDisplay *d, _XCBCheckTable *table)
 {
-    const xcb_get_property_cookie_t cookie = xcb_icccm_get_text_property(display, window, property);
-    return (XCBCookie) {.sequence = cookie.sequence };
+    if(table->tail == table->head)
+    {   return;
+    }
+    xcb_aux_sync(d);
+    ck_poll(d, table);
+    /* only left if the connection broke */
+    for(; table->tail != table->head; ++table->tail)
+    {   xcb_discard_reply(d, table->checks[table->tail & (_XCB_CHECK_TABLE - 1)].sequence);
+    }
 }
+#endif
 
-int 
-XCBGetTextPropertyReply(XCBDisplay *display, XCBCookie cookie, XCBTextProperty *reply_return)
+static void
+ck(XCBDisplay *d, XCBCookie c, const char *func)
 {
+    if(!d || !c.sequence)   /* sequence shouldnt and cant be 0, so we dont handle that */
+    {   
+        fprintf(stderr, "Could not load display into error handler.");
+        XCBBreakPoint();
+        return;
+    }
+#ifdef DEFERRED_CK
+    _XCBDisplayData *dd = _xcb_dpy(d);
+    if(dd && (dd->checks.checks || (dd->checks.checks = malloc(_XCB_CHECK_TABLE * sizeof(_XCBCheck)))))
+    {
+        _XCBCheckTable *table = &dd->checks;
+        _XCBCheck *check;
+        if(table->head - table->tail == _XCB_CHECK_TABLE)
+        {   ck_poll(d, table);
+        }
+        if(table->head - table->tail == _XCB_CHECK_TABLE)
+        {   
+            /* still full, the oldest is given up on */
+            xcb_discard_reply(d, table->checks[table->tail++ & (_XCB_CHECK_TABLE - 1)].sequence);
+            if(!table->evicted++)
+            {   fprintf(stderr, "Deferred check table full, some errors will not be reported.\n");
+            }
+        }
+        check = &table->checks[table->head++ & (_XCB_CHECK_TABLE - 1)];
+        check->sequence = c.sequence;
+        check->time = _xcb_time_ms();
+        check->func = func;
+        return;
+    }
+#endif
     XCBGenericError *err = NULL;
-    int status = 0;
-    const xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
-    status = xcb_icccm_get_text_property_reply(display, cookie1, reply_return, &err);
+    err = xcb_request_check(d, c);
     if(err)
-    {   
-        _xcb_err_handler(display, err);
-        return 0;
+    {   ck_report(d, err, func, 0);
     }
-    return status;
 }
-int
-XCBFreeTextProperty(XCBTextProperty *prop)
-{   
-    xcb_icccm_get_text_property_reply_wipe(prop);
-    return 1;
+
+void  
+XCBBreakPoint(void) 
+{
 }
 
-int 
-XCBFlush(XCBDisplay *display)
+#endif
+
+
+static void
+_xcb_err_handler(XCBDisplay *display, XCBGenericError *err)
 {
-    /* This locks the XServer thread (pthread mutix lock).
-     * and writes the buffer to the server.
-     * RETURN 1 on Success.
-     * RETURN 0 on Failure.
-     */
-    return xcb_flush(display);
+    _XCBDisplayData *dd;
+    if(!err || !display)
+    {   return;
+    }
+    dd = _xcb_dpy(display);
+    if(dd && _xcb_err_ring_take(&dd->errors, err))
+    {
+        free(err);
+        return;
+    }
+#ifdef DBG
+    jmpck(display, err);
+    free(err);
+    return;
+#endif
+    if(_handler)
+    {   _handler(display, err);
+    }
+    free(err);
+    err = NULL;
 }
 
-u32
-XCBGetMaximumRequestLength(XCBDisplay *display)
+/* What the server has for the fields in mask is unknown until the ConfigureNotify of sequence comes back. */
+static void
+_xcb_cfg_sent(_XCBGeometry *geom, u16 mask, u16 sequence)
 {
-    /* <Straight from the documentation.>
-     *
-     * In the absence of the BIG-REQUESTS extension, returns the
-     * maximum request length field from the connection setup data, which
-     * may be as much as 65535. If the server supports BIG-REQUESTS, then
-     * the maximum request length field from the reply to the
-     * BigRequestsEnable request will be returned instead.
-     *
-     * Note that this length is measured in four-byte units, making the
-     * theoretical maximum lengths roughly 256kB without BIG-REQUESTS and
-     * 16GB with.
+    geom->known &= ~mask;
+    geom->fence = sequence;
+    geom->inflight = 1;
+}
+
+/* Sends a single ConfigureWindow per window with anything pending, in order of their first change. */
+static void
+_xcb_cfg_flush(XCBDisplay *display, _XCBConfigCache *cfg)
+{
+    _XCBGeometry *geom;
+    XCBCookie cookie;
+    u32 values[5];
+    u32 count;
+    u32 i;
+    u32 k;
+    for(i = 0; i < cfg->len; ++i)
+    {
+        geom = _xcb_cfg_get(cfg, cfg->dirty[i], 0);
+        if(!geom)
+        {   continue;
+        }
+        geom->listed = 0;
+        if(!geom->dirty)
+        {   continue;
+        }
+        for(k = count = 0; k < 5; ++k)
+        {
+            if(geom->dirty & (1 << k))
+            {   values[count++] = geom->pending[k];
+            }
+        }
+#ifdef DBG
+        cookie = xcb_configure_window_checked(display, cfg->dirty[i], geom->dirty, values);
+        ck(display, cookie, "XCBFlush");
+#else
+        cookie = xcb_configure_window(display, cfg->dirty[i], geom->dirty, values);
+#endif
+        _xcb_cfg_sent(geom, geom->dirty, cookie.sequence);
+        geom->dirty = 0;
+    }
+    cfg->len = 0;
+}
+
+/* Sends whatever configures are held back, anything that can observe or overtake them calls this first. */
+static void
+_xcb_cfg_before(XCBDisplay *display)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd && dd->configs.len)
+    {   _xcb_cfg_flush(display, &dd->configs);
+    }
+}
+
+/* Routes a configure through the cache when it is on, see XCBSetConfigureCache().
+ *
+ * values:          1 per bit of mask, in bit order.
+ * cookie_return:   Sequence 0 when the cache held it back.
+ *
+ * RETURN: 1 when the cache took it, nothing is to be sent.
+ * RETURN: 0 when it should be sent now.
+ */
+static int
+_xcb_cfg_take(XCBDisplay *display, XCBWindow window, u16 mask, const u32 *values, XCBCookie *cookie_return)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBGeometry *geom;
+    if(!dd || !dd->configs.enabled)
+    {   return 0;
+    }
+    if(!(mask & ~_XCB_GEOMETRY_MASK) && _xcb_cfg_merge(&dd->configs, window, mask, values))
+    {
+        cookie_return->sequence = 0;
+        return 1;
+    }
+    /* stacking (or no memory), whatever is pending must go out before it */
+    _xcb_cfg_flush(display, &dd->configs);
+#ifdef DBG
+    *cookie_return = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, *cookie_return, "XCBConfigureWindow");
+#else
+    *cookie_return = xcb_configure_window(display, window, mask, values);
+#endif
+    geom = _xcb_cfg_get(&dd->configs, window, 0);
+    if(geom)
+    {   _xcb_cfg_sent(geom, mask & _XCB_GEOMETRY_MASK, cookie_return->sequence);
+    }
+    return 1;
+}
+
+int
+XCBSetErrorRing(
+        XCBDisplay *display,
+        int enable
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd)
+    {   return 0;
+    }
+    dd->errors.enabled = !!enable;
+    return 1;
+}
+
+int
+XCBSetErrorRateLimit(
+        XCBDisplay *display,
+        u8 error_code,
+        u16 per_second
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd)
+    {   return 0;
+    }
+    dd->errors.limits[error_code] = per_second;
+    return 1;
+}
+
+u32
+XCBDrainErrors(
+        XCBDisplay *display,
+        XCBGenericError *errors_return,
+        u32 max
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBErrorRing *ring;
+    u32 head;
+    u32 tail;
+    u32 count;
+    u32 i;
+    if(!dd)
+    {   return 0;
+    }
+    ring = &dd->errors;
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    count = head - tail < max ? head - tail : max;
+    for(i = 0; i < count; ++i)
+    {   errors_return[i] = ring->errors[(tail + i) & (_XCB_ERROR_RING - 1)];
+    }
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    return count;
+}
+
+void
+XCBGetErrorRingStats(
+        XCBDisplay *display,
+        u32 *dropped_return,
+        u32 *suppressed_return
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dropped_return)
+    {   *dropped_return = dd ? atomic_load_explicit(&dd->errors.dropped, memory_order_relaxed) : 0;
+    }
+    if(suppressed_return)
+    {   *suppressed_return = dd ? dd->errors.suppressed : 0;
+    }
+}
+
+XCBDisplay *
+XCBOpenDisplay(const char *displayName, int *defaultScreenReturn)
+{
+    XCBDisplay *display = xcb_connect(displayName, defaultScreenReturn);
+    /* We need to check return type cause xcb_connect never returns NULL (for some reason).
+     * So we just check error, which requires display.
      */
-    return xcb_get_maximum_request_length(display);
+    if(!display || xcb_connection_has_error(display))
+    {   
+        /* This frees the connection data that was allocated. */
+        xcb_disconnect(display);
+        return NULL;
+    }
+    /* builds the screen table */
+    _XCBDisplayData *dd = _xcb_dpy(display);
+#ifdef ATOM_CACHE
+    if(dd)
+    {   _xcb_atom_cache_load(display, displayName, dd);
+    }
+#else
+    (void)dd;
+#endif
+    return display;
+}
+XCBDisplay *
+XCBOpenConnection(const char *displayName, int *defaultScreenReturn)
+{
+    return xcb_connect(displayName, defaultScreenReturn);
+}
+void 
+XCBCloseDisplay(XCBDisplay *display)
+{
+    /* held back configures are still owed to the server, xcb_disconnect() drops anything unwritten */
+    _xcb_cfg_before(display);
+#ifdef DEFERRED_CK
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   ck_flush(display, &dd->checks);
+    }
+#endif
+    xcb_flush(display);
+    _xcb_dpy_free(display);
+    /* Closes connection and frees resulting data. */
+    xcb_disconnect(display);
+}
+
+int 
+XCBDisplayNumber(XCBDisplay *display)
+{
+    /* gets the file descriptor AKA the connection number */
+    return xcb_get_file_descriptor(display);
 }
 
 int
-XCBCheckDisplayError(XCBDisplay *display)
-{   return xcb_connection_has_error(display);
+XCBConnectionNumber(XCBDisplay *display)
+{
+    /* gets the file descriptor AKA the connection number */
+    return xcb_get_file_descriptor(display);
+}
+
+/* The screen table of display, without taking _dpys_lock when this thread asked for the same display last
+ * and no display was closed since (a new display may get a closed ones address).
+ *
+ * RETURN: NULL on Failure.
+ */
+static _XCBScreenTable *
+_xcb_screens(XCBDisplay *display)
+{
+    const u32 freed = atomic_load(&_dpys_freed);
+    _XCBDisplayData *dd;
+    if(display && display == _screens_display && freed == _screens_freed)
+    {   return _screens_table;
+    }
+    dd = _xcb_dpy(display);
+    if(!dd)
+    {   return NULL;
+    }
+    _screens_display = display;
+    _screens_table = &dd->screens;
+    _screens_freed = freed;
+    return &dd->screens;
+}
+
+/* HELPER FUNCTION */
+static const _XCBScreenInfo *
+screen_of_display(XCBDisplay *display, int screen)
+{
+    const _XCBScreenTable *st = _xcb_screens(display);
+    if(!st || screen < 0 || (u32)screen >= st->count)
+    {   return NULL;
+    }
+    return st->screens + screen;
+}
+
+XCBScreen *
+XCBScreenOfDisplay(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    return info ? info->screen : NULL;
+}
+
+XCBScreen *
+XCBDefaultScreenOfDisplay(XCBDisplay *display, int screen)
+{
+    return XCBScreenOfDisplay(display, screen);
 }
+
+
 int 
-XCBHasConnectionError(XCBDisplay *display)
-{   return xcb_connection_has_error(display);
+XCBScreenCount(XCBDisplay *display)
+{
+    const _XCBScreenTable *st = _xcb_screens(display);
+    return st ? st->count : 0;
+}
+
+char *
+XCBServerVendor(XCBDisplay *display)
+{
+    char *vendor = NULL;
+    int length = 0;
+
+    length = xcb_setup_vendor_length (xcb_get_setup (display));
+    vendor = (char *)malloc (length + 1);
+    if (vendor)
+    {
+        memcpy (vendor, xcb_setup_vendor (xcb_get_setup (display)), length);
+        vendor[length] = '\0';
+    }
+    return vendor;
 }
+
+
+/* All of these use xcb_get_setup
+ * The reason we can is because the access is essential O(1)
+ * This is because xcb_get_setup() simply calls a error check and returns a adress
+ * display->setup basically
+ */
+
 int 
-XCBCheckConnectionError(XCBDisplay *display)
+XCBProtocolVersion(XCBDisplay *display)
 {
-    return xcb_connection_has_error(display);
+    return xcb_get_setup(display)->protocol_major_version;
 }
+
 int 
-XCBHasDisplayError(XCBDisplay *display)
-{   return xcb_connection_has_error(display);
+XCBProtocolRevision(XCBDisplay *display)
+{   return xcb_get_setup(display)->protocol_minor_version;
 }
 
 int
-XCBSetErrorHandler(void (*error_handler)(XCBDisplay *, XCBGenericError *))
-{   return !!(_handler = error_handler);
+XCBVendorRelease(XCBDisplay *display)
+{   return xcb_get_setup (display)->release_number;
 }
 
-void
-XCBSetIOErrorHandler(XCBDisplay *display, void *IOHandler)
-{   /* not implemented */
-    (void)display;
-    (void)IOHandler;
-    return;
+int
+XCBBitmapUnit(XCBDisplay *display)
+{   return xcb_get_setup(display)->bitmap_format_scanline_unit;
 }
 
-char *
-XCBErrorCodeText(
-        uint8_t error_code)
+int
+XCBBitmapBitOrder(XCBDisplay *display)
+{   return xcb_get_setup(display)->bitmap_format_bit_order;
+}
+
+int
+XCBBitmapPad(XCBDisplay *display)
+{   return xcb_get_setup(display)->bitmap_format_scanline_pad;
+}
+
+int
+XCBImageByteOrder(XCBDisplay *display)
+{   return xcb_get_setup(display)->image_byte_order;
+}
+
+const XCBSetup *
+XCBGetSetup(XCBDisplay *display)
 {
-    char *errs[18] =
-    {
-        [0] = NULL,
-        [BadRequest] = "BadRequest",
-        [BadValue] = "BadValue",
-        [BadWindow] = "BadWindow",
-        [BadPixmap] = "BadPixmap",
-        [BadAtom] = "BadAtom",
-        [BadCursor] = "BadCursor",
-        [BadFont] = "BadFont",
-        [BadMatch] = "BadMatch",
-        [BadDrawable] = "BadDrawable",
-        [BadAccess] = "BadAccess",
-        [BadAlloc] = "BadAlloc",
-        [BadColor] = "BadColor",
-        [BadGC] = "BadGC",
-        [BadIDChoice] = "BadIDChoice",
-        [BadName] = "BadName",
-        [BadLength] = "BadLength",
-        [BadImplementation] = "BadImplementation",
-    };
-    /* bounds check */      /* & over && for better inlining */
-    error_code *= (error_code > 0) & (error_code < 18);
-    return errs[error_code];
+    return xcb_get_setup(display);
 }
 
-char *
-XCBErrorMajorCodeText(
-        uint8_t major_code)
+XCBScreen *
+XCBGetScreen(XCBDisplay *display)
 {
-    char *errs[128] = 
-    {
-        [0] = NULL,
-        [X_CreateWindow] = "CreateWindow",
-        [X_ChangeWindowAttributes] = "ChangeWindowAttributes",
-        [X_GetWindowAttributes] = "GetWindowAttributes",
-        [X_DestroyWindow] = "DestroyWindow",
-        [X_DestroySubwindows] = "DestroySubwindows",
-        [X_ChangeSaveSet] = "ChangeSaveSet",
-        [X_ReparentWindow] = "ReparentWindow",
-        [X_MapWindow] = "MapWindow",
-        [X_MapSubwindows] = "MapSubwindows",
-        [X_UnmapWindow] = "UnmapWindow",
-        [X_UnmapSubwindows] = "UnmapSubwindows",
-        [X_ConfigureWindow] = "ConfigureWindow",
-        [X_CirculateWindow] = "CirculateWindow",
-        [X_GetGeometry] = "GetGeometry",
-        [X_QueryTree] = "QueryTree",
-        [X_InternAtom] = "InternAtom",
-        [X_GetAtomName] = "GetAtomName",
-        [X_ChangeProperty] = "ChangeProperty",
-        [X_DeleteProperty] = "DeleteProperty",
-        [X_GetProperty] = "GetProperty",
+    return XCBScreenOfDisplay(display, 0);
+}
+
+XCBWindow
+XCBRootWindow(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    if(info)
+    {   return info->root;
+    }
+    return 0; /* AKA NULL; AKA we didnt find a screen */
+}
+
+XCBWindow
+XCBDefaultRootWindow(XCBDisplay *display, int screen)
+{
+    return XCBRootWindow(display, screen);
+}
+
+u16 XCBDisplayWidth(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    return info ? info->width : 0;
+}
+u16
+XCBDisplayHeight(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    return info ? info->height : 0;
+}
+u8
+XCBDisplayDepth(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    return info ? info->depth : 0;
+}
+u8
+XCBDefaultDepth(XCBDisplay *display, int screen)
+{
+    return XCBDisplayDepth(display, screen);
+}
+
+XCBVisual
+XCBDefaultVisual(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    return info ? info->root_visual : 0;
+}
+
+XCBVisualType *
+XCBFindVisualType(
+        XCBDisplay *display,
+        XCBVisual visual,
+        u8 *depth_return,
+        int *screen_return
+        )
+{
+    _XCBScreenTable *st = _xcb_screens(display);
+    const _XCBVisualInfo *info;
+    void **slot;
+    if(!st || !visual)
+    {   return NULL;
+    }
+    slot = _xcb_map_get(&st->index, visual);
+    if(!slot)
+    {   return NULL;
+    }
+    info = *slot;
+    if(depth_return)
+    {   *depth_return = info->depth;
+    }
+    if(screen_return)
+    {   *screen_return = info->screen;
+    }
+    return info->visual;
+}
+
+/* Any event-mask change may (de)select PropertyChange, so the window is learned again on its next miss. */
+static void
+_xcb_prop_select(XCBDisplay *display, XCBWindow window)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd && dd->props.enabled)
+    {   _xcb_prop_forget(&dd->props, window, XCB_NONE);
+    }
+}
+
+XCBCookie
+XCBSelectInput(XCBDisplay *display, XCBWindow window, u32 mask)
+{
+    _xcb_prop_select(display, window);
+#ifdef DBG
+    XCBCookie cookie = xcb_change_window_attributes_checked(display, window, XCB_CW_EVENT_MASK, &mask);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+
+    return xcb_change_window_attributes(display, window, XCB_CW_EVENT_MASK, &mask);
+}
+
+XCBCookie
+XCBSetInputFocus(XCBDisplay *display, XCBWindow window, u8 revert_to, XCBTimestamp tim)
+{
+#ifdef DBG
+    XCBCookie cookie = xcb_set_input_focus_checked(display, revert_to, window, tim);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+
+    return xcb_set_input_focus(display, revert_to, window, tim);
+}
+
+XCBCookie
+XCBChangeWindowAttributes(XCBDisplay *display, XCBWindow window, u32 mask, XCBWindowAttributes *window_attributes)
+{
+    if(mask & XCB_CW_EVENT_MASK)
+    {   _xcb_prop_select(display, window);
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_change_window_attributes_aux_checked(display, window, mask, window_attributes);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_change_window_attributes_aux(display, window, mask, window_attributes);
+}
+
+u32
+XCBBlackPixel(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    if(info)
+    {   return info->black_pixel;
+    }
+    return 0; /* AKA NULL; AKA we didnt find a screen */
+}
+
+u32
+XCBWhitePixel(XCBDisplay *display, int screen)
+{
+    const _XCBScreenInfo *info = screen_of_display(display, screen);
+    if(info)
+    {   return info->white_pixel;
+    }
+    return 0; /* AKA NULL; AKA we didnt find a screen */
+}
+
+void
+XCBSync(XCBDisplay *display)
+{ 
+    /* "https://community.kde.org/Xcb"
+     * The xcb equivalent of XSync() is xcb_aux_sync(), which is in xcb-utils.
+     * The reason you won't find a sync function in libxcb is that there is no sync request in the X protocol. 
+     * Calling XSync() or xcb_aux_sync() is equivalent to calling XGetInputFocus() and throwing away the reply.
+     */
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd && dd->configs.len)
+    {   _xcb_cfg_flush(display, &dd->configs);
+    }
+    xcb_aux_sync(display);
+#ifdef DEFERRED_CK
+    if(dd)
+    {   ck_poll(display, &dd->checks);
+    }
+#endif
+}
+
+void
+XCBSyncf(XCBDisplay *display)
+{
+    /* analagous to XSync(display, True) */
+    XCBSync(display);
+    XCBGenericEvent *ev = NULL;
+    while(((ev = XCBPollForQueuedEvent(display))))
+    {   
+        if(!ev->response_type)
+        {   _xcb_err_handler(display, (xcb_generic_error_t *)ev);
+        }
+        else
+        {   free(ev);
+        }
+    }
+}
+
+
+
+
+XCBCookie
+XCBMoveWindow(XCBDisplay *display, XCBWindow window, i32 x, i32 y)
+{
+    const i32 values[4] = { x, y };
+    const u16 mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, values);
+}
+
+XCBCookie
+XCBMoveResizeWindow(XCBDisplay *display, XCBWindow window, i32 x, i32 y, u32 width, u32 height)
+{
+    /* x and y go out as their 32 bit two's complement, in bit order of the mask */
+    const u32 values[4] = { (u32)x, (u32)y, width, height };
+    const u16 mask = XCB_CONFIG_WINDOW_X|XCB_CONFIG_WINDOW_Y|XCB_CONFIG_WINDOW_WIDTH|XCB_CONFIG_WINDOW_HEIGHT;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, values);
+}
+
+XCBCookie
+XCBResizeWindow(XCBDisplay *display, XCBWindow window, u32 width, u32 height)
+{
+    const u32 values[4] = { width, height };
+    const u32 mask = XCB_CONFIG_WINDOW_WIDTH|XCB_CONFIG_WINDOW_HEIGHT;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+
+    return xcb_configure_window(display, window, mask, values);
+}
+
+XCBCookie
+XCBRaiseWindow(XCBDisplay *display, XCBWindow window)
+{
+    const u32 values[1] = { XCB_STACK_MODE_ABOVE };
+    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBMapRaised(XCBDisplay *display, XCBWindow window)
+{
+    _xcb_cfg_before(display);
+    xcb_map_window(display, window);
+#ifdef DBG
+    XCBCookie cookie = xcb_map_window_checked(display, window);
+    ck(display, cookie, _fn);
+    return XCBRaiseWindow(display, window);
+#endif
+    return XCBRaiseWindow(display, window);
+}
+
+XCBCookie
+XCBLowerWindow(XCBDisplay *display, XCBWindow window)
+{
+    const u32 values[1] = { XCB_STACK_MODE_BELOW };
+    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBRaiseWindowIf(XCBDisplay *display, XCBWindow window)
+{
+    const u32 values[1] = { XCB_STACK_MODE_TOP_IF };
+    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBLowerWindowIf(XCBDisplay *display, XCBWindow window)
+{
+    const u32 values[1] = { XCB_STACK_MODE_BOTTOM_IF };
+    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBRaiseLowerWindow(XCBDisplay *display, XCBWindow window)
+{
+    const u32 values[1] = { XCB_STACK_MODE_OPPOSITE };
+    const u32 mask = XCB_CONFIG_WINDOW_STACK_MODE;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBSetWindowBorderWidth(XCBDisplay *display, XCBWindow window, u32 border_width)
+{
+    const u32 values[1] = { border_width };
+    const u32 mask = XCB_CONFIG_WINDOW_BORDER_WIDTH;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBSetSibling(XCBDisplay *display, XCBWindow window, XCBWindow sibling)
+{
+    const u32 values[1] = { sibling };
+    const u32 mask = XCB_CONFIG_WINDOW_SIBLING;
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, mask, (const u32 *)values, &taken))
+    {   return taken;
+    }
+#ifdef DBG
+    XCBCookie cookie = xcb_configure_window_checked(display, window, mask, values);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_configure_window(display, window, mask, &values);
+}
+
+XCBCookie
+XCBGetWindowAttributesCookie(XCBDisplay *display, XCBWindow window)
+{
+    _xcb_cfg_before(display);
+    const xcb_get_window_attributes_cookie_t cookie = xcb_get_window_attributes(display, window);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+XCBGetWindowAttributes *
+XCBGetWindowAttributesReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    XCBGetWindowAttributes *reply = NULL;
+    const xcb_get_window_attributes_cookie_t cookie1 = { .sequence = cookie.sequence };
+    reply = xcb_get_window_attributes_reply(display, cookie1, &err);
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+XCBCookie
+XCBGetWindowGeometryCookie(XCBDisplay *display, XCBWindow window)
+{
+    _xcb_cfg_before(display);
+    const xcb_get_geometry_cookie_t cookie = xcb_get_geometry(display, window);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+XCBGeometry *
+XCBGetWindowGeometryReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    XCBGeometry *reply = NULL;
+    const xcb_get_geometry_cookie_t cookie1 = { .sequence = cookie.sequence };
+    reply = xcb_get_geometry_reply(display, cookie1, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+
+XCBCookie
+XCBGetGeometryCookie(
+        XCBDisplay *display,
+        XCBWindow window)
+{
+    return XCBGetWindowGeometryCookie(display, window);
+}
+
+XCBGeometry *
+XCBGetGeometryReply(
+        XCBDisplay *display,
+        XCBCookie cookie
+        )
+{
+    return XCBGetWindowGeometryReply(display, cookie);
+}
+
+
+XCBCookie
+XCBInternAtomCookie(XCBDisplay *display, const char *name, int only_if_exists)
+{
+    const xcb_intern_atom_cookie_t cookie = xcb_intern_atom(display, only_if_exists, strlen(name), name);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+XCBAtom
+XCBInternAtomReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    const xcb_intern_atom_cookie_t cookie1 = { .sequence = cookie.sequence };
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(display, cookie1, &err);
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return 0;
+    }
+    const xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+u32
+XCBInternAtoms(
+        XCBDisplay *display,
+        const char *const *names,
+        u32 count,
+        int only_if_exists,
+        XCBAtom *atoms_return
+        )
+{
+    _XCBAtomTable *table = _xcb_dpy_atoms(display);
+    i32 *indices;
+    u32 resolved = 0;
+    u32 len;
+    u32 hash;
+    u32 i;
+    i32 index;
+
+    if(!count)
+    {   return 0;
+    }
+    indices = malloc(count * sizeof(i32));
+    if(!table || !indices)
+    {   
+        /* out of memory, do it the slow way */
+        free(indices);
+        for(i = 0; i < count; ++i)
+        {
+            atoms_return[i] = names[i] ? XCBInternAtomReply(display, XCBInternAtomCookie(display, names[i], only_if_exists)) : XCB_NONE;
+            resolved += !!atoms_return[i];
+        }
+        return resolved;
+    }
+
+    /* send every missing name first, duplicates share the same request */
+    for(i = 0; i < count; ++i)
+    {
+        indices[i] = -1;
+        atoms_return[i] = XCB_NONE;
+        if(!names[i])
+        {   continue;
+        }
+        len = strlen(names[i]);
+        hash = _xcb_hash_str(names[i], len);
+        index = _xcb_atom_find(table, names[i], len, hash);
+        if(index != -1 && table->entries[index].atom)
+        {   
+            atoms_return[i] = table->entries[index].atom;
+            continue;
+        }
+        if(index == -1)
+        {   index = _xcb_atom_insert(table, names[i], len, hash, XCB_NONE, 1);
+        }
+        if(index == -1)
+        {   
+            atoms_return[i] = XCBInternAtomReply(display, XCBInternAtomCookie(display, names[i], only_if_exists));
+            continue;
+        }
+        if(!table->entries[index].pending)
+        {
+            table->entries[index].cookie = XCBInternAtomCookie(display, names[i], only_if_exists).sequence;
+            table->entries[index].pending = 1;
+        }
+        indices[i] = index;
+    }
+
+    /* then collect them, in order */
+    for(i = 0; i < count; ++i)
+    {
+        if(indices[i] != -1)
+        {
+            _XCBAtomEntry *entry = &table->entries[indices[i]];
+            if(entry->pending)
+            {   _xcb_atom_resolve(table, indices[i], XCBInternAtomReply(display, (XCBCookie) { .sequence = entry->cookie }));
+            }
+            atoms_return[i] = entry->atom;
+        }
+        resolved += !!atoms_return[i];
+    }
+    free(indices);
+    return resolved;
+}
+
+XCBAtom
+XCBInternAtom(
+        XCBDisplay *display,
+        const char *name,
+        int only_if_exists
+        )
+{
+    XCBAtom atom = XCB_NONE;
+    XCBInternAtoms(display, &name, 1, only_if_exists, &atom);
+    return atom;
+}
+
+XCBAtom
+XCBLookupAtom(
+        XCBDisplay *display,
+        const char *name
+        )
+{
+    _XCBAtomTable *table = _xcb_dpy_atoms(display);
+    u32 len;
+    i32 index;
+    if(!table || !name)
+    {   return XCB_NONE;
+    }
+    len = strlen(name);
+    index = _xcb_atom_find(table, name, len, _xcb_hash_str(name, len));
+    return index != -1 ? table->entries[index].atom : XCB_NONE;
+}
+
+const char *
+XCBLookupAtomName(
+        XCBDisplay *display,
+        XCBAtom atom
+        )
+{
+    _XCBAtomTable *table = _xcb_dpy_atoms(display);
+    void **slot;
+    if(!table || !atom)
+    {   return NULL;
+    }
+    slot = _xcb_map_get(&table->atoms, atom);
+    return slot ? table->entries[(uintptr_t)*slot - 1].name : NULL;
+}
+
+XCBCookie
+XCBGetAtomNameCookie(XCBDisplay *display, XCBAtom atom)
+{
+    const xcb_get_atom_name_cookie_t cookie = xcb_get_atom_name(display, atom);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+char *
+XCBGetAtomNameReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    const xcb_get_atom_name_cookie_t cookie1 = { .sequence = cookie.sequence };
+    xcb_get_atom_name_reply_t *reply = xcb_get_atom_name_reply(display, cookie1, &err);
+    char *name;
+    int len;
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    len = xcb_get_atom_name_name_length(reply);
+    name = malloc(len + 1);
+    if(name)
+    {
+        memcpy(name, xcb_get_atom_name_name(reply), len);
+        name[len] = '\0';
+    }
+    free(reply);
+    return name;
+}
+
+/* Collects a GetAtomName reply straight into the atom table.
+ *
+ * RETURN: Stored name on Success.
+ * RETURN: NULL on Failure.
+ */
+static const char *
+_xcb_atom_name_collect(XCBDisplay *display, _XCBAtomTable *table, XCBAtom atom, u32 sequence)
+{
+    XCBGenericError *err = NULL;
+    const xcb_get_atom_name_cookie_t cookie = { .sequence = sequence };
+    xcb_get_atom_name_reply_t *reply = xcb_get_atom_name_reply(display, cookie, &err);
+    const char *name;
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    name = _xcb_atom_learn(table, atom, xcb_get_atom_name_name(reply), xcb_get_atom_name_name_length(reply));
+    free(reply);
+    return name;
+}
+
+u32
+XCBGetAtomNames(
+        XCBDisplay *display,
+        const XCBAtom *atoms,
+        u32 count,
+        const char **names_return
+        )
+{
+    _XCBAtomTable *table = _xcb_dpy_atoms(display);
+    _XCBMap inflight = { 0 };      /* atoms asked for in this call, NULL once they failed */
+    u32 *sequences;
+    u32 resolved = 0;
+    u8 sent = 0;
+    void **slot;
+    u32 i;
+
+    if(!count)
+    {   return 0;
+    }
+    sequences = malloc(count * sizeof(u32));
+    if(!table || !sequences)
+    {
+        free(sequences);
+        for(i = 0; i < count; ++i)
+        {   names_return[i] = NULL;
+        }
+        return 0;
+    }
+
+    /* send every unknown atom first, duplicates share the same request */
+    for(i = 0; i < count; ++i)
+    {
+        names_return[i] = NULL;
+        if(!atoms[i])
+        {   continue;
+        }
+        slot = _xcb_map_get(&table->atoms, atoms[i]);
+        if(slot)
+        {   
+            names_return[i] = table->entries[(uintptr_t)*slot - 1].name;
+            continue;
+        }
+        slot = _xcb_map_get(&inflight, atoms[i]);
+        if(slot)
+        {   
+            sequences[i] = sequences[(uintptr_t)*slot - 1];
+            continue;
+        }
+        sequences[i] = XCBGetAtomNameCookie(display, atoms[i]).sequence;
+        sent = 1;
+        slot = _xcb_map_set(&inflight, atoms[i]);
+        if(slot)
+        {   *slot = (void *)(uintptr_t)(i + 1);
+        }
+    }
+    if(sent)
+    {   xcb_flush(display);
+    }
+
+    /* then collect them, in order */
+    for(i = 0; i < count; ++i)
+    {
+        if(atoms[i] && !names_return[i])
+        {
+            slot = _xcb_map_get(&table->atoms, atoms[i]);
+            if(slot)
+            {   /* a duplicate already collected it */
+                names_return[i] = table->entries[(uintptr_t)*slot - 1].name;
+            }
+            else
+            {   
+                slot = _xcb_map_get(&inflight, atoms[i]);
+                if(!slot || *slot)
+                {   names_return[i] = _xcb_atom_name_collect(display, table, atoms[i], sequences[i]);
+                }
+                if(!names_return[i] && slot)
+                {   *slot = NULL;
+                }
+            }
+        }
+        resolved += !!names_return[i];
+    }
+    _xcb_map_wipe(&inflight);
+    free(sequences);
+    return resolved;
+}
+
+const char *
+XCBGetAtomName(
+        XCBDisplay *display,
+        XCBAtom atom
+        )
+{
+    const char *name = NULL;
+    XCBGetAtomNames(display, &atom, 1, &name);
+    return name;
+}
+
+XCBCookie
+XCBGetTransientForHintCookie(
+        XCBDisplay *display, 
+        XCBWindow win)
+{
+    xcb_get_property_cookie_t cookie = xcb_icccm_get_wm_transient_for(display, win);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+u8
+XCBGetTransientForHintReply(
+        XCBDisplay *display,
+        XCBCookie cookie,
+        XCBWindow *win
+        )
+{
+    XCBGenericError *err = NULL;
+    xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
+    const u8 status = xcb_icccm_get_wm_transient_for_reply(display, cookie1, win, &err);
+
+    if(err)
+    {   _xcb_err_handler(display, err);
+        return 0;
+    }
+    return status;
+}
+
+XCBCookie
+XCBGetPropertyCookie(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        uint32_t long_offset,
+        uint32_t long_length,
+        uint8_t _delete,
+        XCBAtom req_type
+        )
+{
+    const xcb_get_property_cookie_t cookie = xcb_get_property(display, _delete, window, property, req_type, long_offset, long_length);
+    return (XCBCookie) {.sequence = cookie.sequence };
+}
+
+XCBCookie 
+XCBGetWindowPropertyCookie(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        uint32_t long_offset,
+        uint32_t long_length,
+        uint8_t _delete,
+        XCBAtom req_type
+        )
+{
+    const xcb_get_property_cookie_t cookie = xcb_get_property(display, _delete, window, property, req_type, long_offset, long_length);
+    return (XCBCookie) {.sequence = cookie.sequence };
+}
+
+XCBWindowProperty *
+XCBGetWindowPropertyReply(
+        XCBDisplay *display,
+        XCBCookie cookie
+        )
+{
+    XCBGenericError *err = NULL;
+    const xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(display, cookie1, &err);
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+void *
+XCBGetWindowPropertyValue(XCBWindowProperty *reply)
+{
+    return xcb_get_property_value(reply);
+}
+
+u32
+XCBGetWindowPropertyValueSize(XCBWindowProperty *reply)
+{
+    return xcb_get_property_value_length(reply);
+}
+
+u32
+XCBGetWindowPropertyValueLength(XCBWindowProperty *reply, size_t size)
+{
+    return xcb_get_property_value_length(reply) / (size);
+}
+
+#define _XCB_READ_CHUNK         16384
+#define _XCB_READ_DEPTH         4
+
+int
+XCBReadProperty(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        XCBAtom req_type,
+        u32 chunk_length,
+        u32 depth,
+        XCBPropertyChunkCallback callback,
+        void *data
+        )
+{
+    XCBGenericError *err = NULL;
+    XCBPropertyChunk chunk;
+    xcb_get_property_reply_t *reply;
+    u32 *sequences;
+    u32 head = 0;
+    u32 tail = 0;
+    u32 inflight = 0;
+    u32 next;
+    u32 want;
+    int ret = 0;
+
+    if(!chunk_length)
+    {   chunk_length = _XCB_READ_CHUNK;
+    }
+    if(!depth)
+    {   depth = _XCB_READ_DEPTH;
+    }
+    /* keep every offset a whole long, and a chunk within u32 bytes */
+    if(chunk_length > UINT32_MAX / 4)
+    {   chunk_length = UINT32_MAX / 4;
+    }
+    sequences = malloc(depth * sizeof(u32));
+    if(!sequences)
+    {   return 0;
+    }
+    reply = xcb_get_property_reply(display, xcb_get_property(display, 0, window, property, req_type, 0, chunk_length), &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        goto FAILURE;
+    }
+    if(!reply || reply->type == XCB_NONE || (req_type != XCB_GET_PROPERTY_TYPE_ANY && reply->type != req_type))
+    {   goto FAILURE;
+    }
+    chunk.type = reply->type;
+    chunk.format = reply->format;
+    chunk.offset = 0;
+    chunk.length = xcb_get_property_value_length(reply);
+    chunk.total = chunk.length + reply->bytes_after;
+    chunk.data = xcb_get_property_value(reply);
+    next = chunk.length;
+    while(1)
+    {
+        /* a empty property is still 1 (empty) chunk, so its type is known */
+        if((chunk.length || !chunk.total) && callback(display, &chunk, data))
+        {   break;
+        }
+        chunk.offset += chunk.length;
+        free(reply);
+        reply = NULL;
+        if(chunk.offset == chunk.total)
+        {   break;
+        }
+        /* top up the pipeline before waiting on the oldest one */
+        while(inflight < depth && next < chunk.total)
+        {
+            sequences[tail++ % depth] = xcb_get_property(display, 0, window, property, req_type, next / 4, chunk_length).sequence;
+            want = chunk.total - next;
+            next += want < chunk_length * 4 ? want : chunk_length * 4;
+            ++inflight;
+        }
+        --inflight;
+        reply = xcb_get_property_reply(display, (xcb_get_property_cookie_t){ .sequence = sequences[head++ % depth] }, &err);
+        if(err)
+        {
+            _xcb_err_handler(display, err);
+            goto FAILURE;
+        }
+        if(!reply)
+        {   goto FAILURE;
+        }
+        want = chunk.total - chunk.offset;
+        if(want > chunk_length * 4)
+        {   want = chunk_length * 4;
+        }
+        chunk.length = xcb_get_property_value_length(reply);
+        /* changed under us */
+        if(reply->type != chunk.type || reply->format != chunk.format || chunk.length != want 
+        || reply->bytes_after != chunk.total - chunk.offset - chunk.length)
+        {   goto FAILURE;
+        }
+        chunk.data = xcb_get_property_value(reply);
+    }
+    ret = 1;
+FAILURE:
+    while(inflight--)
+    {   xcb_discard_reply(display, sequences[head++ % depth]);
+    }
+    free(reply);
+    free(sequences);
+    return ret;
+}
+
+typedef struct _XCBReadBuffer _XCBReadBuffer;
+struct _XCBReadBuffer
+{
+    u8 *buffer;
+    u32 size;
+    XCBAtom type;
+    u8 format;
+    u32 total;
+};
+
+static int
+_xcb_read_into(XCBDisplay *display, const XCBPropertyChunk *chunk, void *data)
+{
+    _XCBReadBuffer *rb = data;
+    u32 len = chunk->length;
+    (void)display;
+    rb->type = chunk->type;
+    rb->format = chunk->format;
+    rb->total = chunk->total;
+    if(chunk->offset < rb->size)
+    {
+        if(len > rb->size - chunk->offset)
+        {   len = rb->size - chunk->offset;
+        }
+        memcpy(rb->buffer + chunk->offset, chunk->data, len);
+    }
+    return chunk->offset + chunk->length >= rb->size;
+}
+
+int
+XCBReadPropertyInto(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        XCBAtom req_type,
+        void *buffer,
+        u32 size,
+        XCBAtom *type_return,
+        u8 *format_return,
+        u32 *length_return
+        )
+{
+    _XCBReadBuffer rb = { .buffer = buffer, .size = size };
+    u32 chunk_length = size / 4 + 1;
+    /* no more than needed, a small buffer then costs 1 small request */
+    if(chunk_length > _XCB_READ_CHUNK)
+    {   chunk_length = _XCB_READ_CHUNK;
+    }
+    if(!XCBReadProperty(display, window, property, req_type, chunk_length, 0, _xcb_read_into, &rb))
+    {   return 0;
+    }
+    *type_return = rb.type;
+    *format_return = rb.format;
+    *length_return = rb.total;
+    return 1;
+}
+
+int
+XCBSetPropertyCache(
+        XCBDisplay *display,
+        size_t max_bytes
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd)
+    {   return 0;
+    }
+    if(!max_bytes)
+    {   
+        _xcb_prop_wipe(&dd->props);
+        return 1;
+    }
+    dd->props.max = max_bytes;
+    dd->props.enabled = 1;
+    _xcb_prop_evict(&dd->props, 0);
+    return 1;
+}
+
+int
+XCBGetCachedProperty(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        XCBAtom req_type,
+        XCBCachedProperty *prop_return
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBPropCache *cache;
+    _XCBPropEntry *entry;
+    xcb_get_window_attributes_cookie_t attrcookie;
+    xcb_get_window_attributes_reply_t *attr;
+    xcb_get_property_cookie_t cookie;
+    xcb_get_property_reply_t *reply;
+    XCBGenericError *err = NULL;
+    void **slot = NULL;
+    u32 length;
+    u8 ask;
+    u8 watched = 0;
+
+    if(!dd)
+    {   return 0;
+    }
+    cache = &dd->props;
+    _xcb_prop_release(cache);
+    if(cache->enabled && (slot = _xcb_map_get(&cache->windows, window)))
+    {
+        for(entry = *slot; entry; entry = entry->next)
+        {
+            if(entry->property == property && entry->req_type == req_type)
+            {
+                _xcb_prop_touch(cache, entry);
+                goto FOUND;
+            }
+        }
+    }
+    /* windows are only kept while they have something cached,
+     * a window that doesnt is asked if it has PropertyChange selected in the same round trip 
+     */
+    ask = cache->enabled && !slot;
+    watched = !!slot;
+    if(ask)
+    {   attrcookie = xcb_get_window_attributes(display, window);
+    }
+    cookie = xcb_get_property(display, 0, window, property, req_type, 0, UINT32_MAX / 4);
+    if(ask)
+    {
+        attr = xcb_get_window_attributes_reply(display, attrcookie, &err);
+        /* the property request gets the same error */
+        free(err);
+        err = NULL;
+        watched = attr && (attr->your_event_mask & XCB_EVENT_MASK_PROPERTY_CHANGE);
+        free(attr);
+    }
+    reply = xcb_get_property_reply(display, cookie, &err);
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        free(reply);
+        return 0;
+    }
+    if(!reply)
+    {   return 0;
+    }
+    length = xcb_get_property_value_length(reply);
+    entry = malloc(sizeof(_XCBPropEntry) + length);
+    if(!entry)
+    {
+        free(reply);
+        return 0;
+    }
+    entry->window = window;
+    entry->property = property;
+    entry->req_type = req_type;
+    entry->type = reply->type;
+    entry->format = reply->format;
+    entry->length = length;
+    memcpy(entry->data, xcb_get_property_value(reply), length);
+    free(reply);
+    slot = NULL;
+    if(watched && sizeof(_XCBPropEntry) + length <= cache->max)
+    {
+        /* evicting first, it may drop the window */
+        _xcb_prop_evict(cache, sizeof(_XCBPropEntry) + length);
+        slot = _xcb_map_set(&cache->windows, window);
+    }
+    if(slot)
+    {
+        entry->next = *slot;
+        *slot = entry;
+        entry->newer = NULL;
+        entry->older = cache->newest;
+        if(cache->newest)
+        {   cache->newest->newer = entry;
+        }
+        else
+        {   cache->oldest = entry;
+        }
+        cache->newest = entry;
+        cache->bytes += sizeof(_XCBPropEntry) + length;
+    }
+    else
+    {   cache->orphan = 1;
+    }
+FOUND:
+    cache->lent = entry;
+    prop_return->type = entry->type;
+    prop_return->format = entry->format;
+    prop_return->length = entry->format ? entry->length / (entry->format / 8) : 0;
+    prop_return->value = entry->data;
+    return 1;
+}
+
+XCBWindowProperty *
+XCBGetPropertyReply(
+        XCBDisplay *display,
+        XCBCookie cookie
+        )
+{
+    XCBGenericError *err = NULL;
+    const xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(display, cookie1, &err);
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+void *
+XCBGetPropertyValue(XCBWindowProperty *reply)
+{
+    return xcb_get_property_value(reply);
+}
+
+u32
+XCBGetPropertyValueSize(
+        XCBWindowProperty *reply
+        )
+{
+    return xcb_get_property_value_length(reply); 
+}
+
+u32
+XCBGetPropertyValueLength(
+        XCBWindowProperty *reply,
+        size_t size
+        )
+{
+    return xcb_get_property_value_length(reply) / size;
+}
+
+
+XCBPixmap
+XCBCreatePixmap(XCBDisplay *display, XCBWindow root, u16 width, u16 height, u8 depth)
+{
+    const XCBPixmap id = xcb_generate_id(display);
+
+#ifdef DBG
+    XCBCookie cookie = xcb_create_pixmap(display, depth, id, root, width, height);
+    ck(display, cookie, _fn);
+    return id;
+#endif
+
+    xcb_create_pixmap(display, depth, id, root, width, height);
+    return id;
+}
+
+/* Cursors */
+
+XCBCursor
+XCBCreateFontCursor(XCBDisplay *display, int shape)
+{
+    /* FORMAT IN RGB: (AKA RED GREEN BLUE) */
+    /* fg = foreground; bg = background */
+    const u16 fgred = 0;
+    const u16 fggreen = 0;
+    const u16 fgblue = 0;
+
+    const u16 bgred = 0;
+    const u16 bggreen = 0;
+    const u16 bgblue = 0;
+
+    const xcb_font_t font = xcb_generate_id(display);
+    const u8 strlenofcursor = 6;    /* X only reads data for those 6 chars so no need for +1 for the \0 character */
+
+    xcb_open_font(display, font, strlenofcursor, "cursor");
+
+    const xcb_cursor_t id = xcb_generate_id(display);
+
+
+#ifdef DBG
+    XCBCookie cookie = xcb_create_glyph_cursor_checked(display, id, font, font, shape, shape + 1,
+                            fgred, fggreen, fgblue,
+                            bgred, bggreen, bgblue);
+    ck(display, cookie, _fn);
+    return id;
+#endif
+
+    xcb_create_glyph_cursor(display, id, font, font, shape, shape + 1,
+                            fgred, fggreen, fgblue,
+                            bgred, bggreen, bgblue);
+    return id;
+}
+
+XCBCookie
+XCBFreeCursor(XCBDisplay *display, XCBCursor cursor)
+{
+    return xcb_free_cursor(display, cursor);
+}
+
+XCBCookie
+XCBDefineCursor(XCBDisplay *display, XCBWindow window, XCBCursor id)
+{   
+    const u32 mask = XCB_CW_CURSOR;
+#if DBG
+    XCBCookie cookie = xcb_change_window_attributes_checked(display, window, mask, &id);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+    return xcb_change_window_attributes(display, window, mask, &id);
+}
+
+XCBCookie
+XCBOpenFont(XCBDisplay *display, XCBFont id, const char *name)
+{
+    const u16 len = strlen(name);
+
+#if DBG
+    XCBCookie cookie = xcb_open_font_checked(display, id, len, name);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+
+    return xcb_open_font(display, id, len, name);
+}
+
+XCBCookie
+XCBCloseFont(XCBDisplay *display, XCBFont id)
+{
+    return xcb_close_font(display, id);
+}
+
+
+/* text property textproperty */
+
+XCBCookie
+XCBGetTextPropertyCookie(XCBDisplay *display, XCBWindow window, XCBAtom property)
+{
+    const xcb_get_property_cookie_t cookie = xcb_icccm_get_text_property(display, window, property);
+    return (XCBCookie) {.sequence = cookie.sequence };
+}
+
+int 
+XCBGetTextPropertyReply(XCBDisplay *display, XCBCookie cookie, XCBTextProperty *reply_return)
+{
+    XCBGenericError *err = NULL;
+    int status = 0;
+    const xcb_get_property_cookie_t cookie1 = { .sequence = cookie.sequence };
+    status = xcb_icccm_get_text_property_reply(display, cookie1, reply_return, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        return 0;
+    }
+    return status;
+}
+int
+XCBFreeTextProperty(XCBTextProperty *prop)
+{   
+    xcb_icccm_get_text_property_reply_wipe(prop);
+    return 1;
+}
+
+int 
+XCBFlush(XCBDisplay *display)
+{
+    /* This locks the XServer thread (pthread mutix lock).
+     * and writes the buffer to the server.
+     * RETURN 1 on Success.
+     * RETURN 0 on Failure.
+     */
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd && dd->configs.len)
+    {   _xcb_cfg_flush(display, &dd->configs);
+    }
+    return xcb_flush(display);
+}
+
+void
+XCBLockDisplay(XCBDisplay *display)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   pthread_mutex_lock(&dd->lock);
+    }
+}
+
+void
+XCBUnlockDisplay(XCBDisplay *display)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   pthread_mutex_unlock(&dd->lock);
+    }
+}
+
+/* Per thread request staging, see XCBStageChangeProperty(). */
+typedef struct _XCBStage _XCBStage;
+
+struct _XCBStage
+{
+    XCBDisplay *display;
+    u32 id;             /* _XCBDisplayData.id, a stale stage for a closed display is dropped */
+    u8 *data;
+    u32 size;
+    u32 cap;
+    u32 count;
+    _XCBStage *next;
+};
+
+/* libxcb wants 1 request with a reply per (1 << 16) - 1 written, and the first one written must have one */
+#define _XCB_STAGE_MAX          ((1 << 16) - 2)
+
+static pthread_key_t _stage_key;
+static pthread_once_t _stage_once = PTHREAD_ONCE_INIT;
+/* display data this thread is taking the socket for, its own take must not count as being asked back */
+static _Thread_local _XCBDisplayData *_stage_writing = NULL;
+
+static void
+_xcb_stage_destroy(void *stages)
+{
+    _XCBStage *stage = stages;
+    _XCBStage *next;
+    for(; stage; stage = next)
+    {
+        next = stage->next;
+        free(stage->data);
+        free(stage);
+    }
+}
+
+static void
+_xcb_stage_key(void)
+{   pthread_key_create(&_stage_key, _xcb_stage_destroy);
+}
+
+/* RETURN: This threads stage for display, with room for size more bytes.
+ * RETURN: NULL on Failure.
+ */
+static _XCBStage *
+_xcb_stage(XCBDisplay *display, u32 size)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBStage *stage;
+    u32 cap;
+    void *p;
+
+    if(!dd)
+    {   return NULL;
+    }
+    pthread_once(&_stage_once, _xcb_stage_key);
+    for(stage = pthread_getspecific(_stage_key); stage; stage = stage->next)
+    {
+        if(stage->display == display)
+        {   break;
+        }
+    }
+    if(!stage)
+    {
+        stage = calloc(1, sizeof(_XCBStage));
+        if(!stage)
+        {   return NULL;
+        }
+        stage->display = display;
+        stage->id = dd->id;
+        stage->next = pthread_getspecific(_stage_key);
+        pthread_setspecific(_stage_key, stage);
+    }
+    if(stage->id != dd->id)
+    {
+        stage->id = dd->id;
+        stage->size = stage->count = 0;
+    }
+    if(stage->count == _XCB_STAGE_MAX)
+    {   return NULL;
+    }
+    if(stage->size + size > stage->cap)
+    {
+        cap = stage->cap ? stage->cap : 4096;
+        while(cap < stage->size + size)
+        {   cap <<= 1;
+        }
+        p = realloc(stage->data, cap);
+        if(!p)
+        {   return NULL;
+        }
+        stage->data = p;
+        stage->cap = cap;
+    }
+    return stage;
+}
+
+/* libxcb calls this from whichever thread sends next, before that thread writes anything (with the iolock dropped).
+ * It waits out a batch being written, and otherwise tells XCBFlushStaged() the socket is gone before it wrote.
+ */
+static void
+_xcb_stage_return(void *closure)
+{
+    _XCBDisplayData *dd = closure;
+    if(_stage_writing == dd)
+    {   return;
+    }
+    pthread_mutex_lock(&dd->stage);
+    while(dd->stage_writing)
+    {   pthread_cond_wait(&dd->staged, &dd->stage);
+    }
+    dd->stage_returned = 1;
+    pthread_mutex_unlock(&dd->stage);
+}
+
+uint32_t
+XCBStageChangeProperty(
+        XCBDisplay *display,
+        XCBWindow window,
+        uint8_t mode,
+        XCBAtom property,
+        XCBAtom type,
+        uint8_t format,
+        uint32_t nelements,
+        const void *data
+        )
+{
+    /* in 64 bits, nelements of format 32 can wrap a u32 back under the limit */
+    const u64 bytes = (u64)nelements * (format / 8);
+    const u64 units = 6 + (bytes + 3) / 4;
+    xcb_change_property_request_t req;
+    _XCBStage *stage;
+
+    if((format != 8 && format != 16 && format != 32) || units > xcb_get_setup(display)->maximum_request_length)
+    {   return UINT32_MAX;
+    }
+    stage = _xcb_stage(display, units * 4);
+    if(!stage)
+    {   return UINT32_MAX;
+    }
+    memset(&req, 0, sizeof(req));
+    req.major_opcode = XCB_CHANGE_PROPERTY;
+    req.mode = mode;
+    req.length = units;
+    req.window = window;
+    req.property = property;
+    req.type = type;
+    req.format = format;
+    req.data_len = nelements;
+    memcpy(stage->data + stage->size, &req, sizeof(req));
+    memcpy(stage->data + stage->size + sizeof(req), data, bytes);
+    memset(stage->data + stage->size + sizeof(req) + bytes, 0, units * 4 - sizeof(req) - bytes);
+    stage->size += units * 4;
+    return stage->count++;
+}
+
+uint32_t
+XCBStageConfigureWindow(
+        XCBDisplay *display,
+        XCBWindow window,
+        uint16_t value_mask,
+        const uint32_t *values
+        )
+{
+    const u32 count = __builtin_popcount(value_mask);
+    const u32 units = 3 + count;
+    _XCBStage *stage = _xcb_stage(display, units * 4);
+    xcb_configure_window_request_t req;
+
+    if(!stage)
+    {   return UINT32_MAX;
+    }
+    memset(&req, 0, sizeof(req));
+    req.major_opcode = XCB_CONFIGURE_WINDOW;
+    req.length = units;
+    req.window = window;
+    req.value_mask = value_mask;
+    memcpy(stage->data + stage->size, &req, sizeof(req));
+    memcpy(stage->data + stage->size + sizeof(req), values, count * sizeof(u32));
+    stage->size += units * 4;
+    return stage->count++;
+}
+
+uint32_t
+XCBFlushStaged(
+        XCBDisplay *display,
+        XCBCookie64 *first_return
+        )
+{
+    /* GetInputFocus, so the batch starts with a request that has a reply */
+    static const u8 sync[4] = { XCB_GET_INPUT_FOCUS, 0, 1, 0 };
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBStage *stage;
+    struct iovec iov[2];
+    uint64_t sent;
+    u32 count;
+    u8 writing;
+    int ok;
+
+    first_return->sequence = 0;
+    if(!dd)
+    {   return 0;
+    }
+    pthread_once(&_stage_once, _xcb_stage_key);
+    for(stage = pthread_getspecific(_stage_key); stage; stage = stage->next)
+    {
+        if(stage->display == display)
+        {   break;
+        }
+    }
+    if(!stage || stage->id != dd->id || !stage->count)
+    {   return 0;
+    }
+    iov[0].iov_base = (void *)sync;
+    iov[0].iov_len = sizeof(sync);
+    iov[1].iov_base = stage->data;
+    iov[1].iov_len = stage->size;
+    count = stage->count;
+    stage->size = stage->count = 0;
+
+    pthread_mutex_lock(&dd->lock);
+    /* staged configures would overtake held back ones, whose stale geometry would then land last */
+    _xcb_cfg_before(display);
+    /* a sender not holding XCBLockDisplay() can ask for the socket back before the batch is written,
+     * sent is stale then, so take it again until nobody did
+     */
+    do
+    {
+        pthread_mutex_lock(&dd->stage);
+        dd->stage_returned = 0;
+        pthread_mutex_unlock(&dd->stage);
+        _stage_writing = dd;
+        ok = xcb_take_socket(display, _xcb_stage_return, dd, 0, &sent);
+        _stage_writing = NULL;
+        pthread_mutex_lock(&dd->stage);
+        dd->stage_writing = writing = ok && !dd->stage_returned;
+        pthread_mutex_unlock(&dd->stage);
+    } while(ok && !writing);
+    if(ok)
+    {
+        ok = xcb_writev(display, iov, 2, count + 1);
+        pthread_mutex_lock(&dd->stage);
+        dd->stage_writing = 0;
+        pthread_cond_broadcast(&dd->staged);
+        pthread_mutex_unlock(&dd->stage);
+    }
+    if(ok)
+    {
+        /* nobody wrote in between, the GetInputFocus is sent + 1 */
+        xcb_discard_reply64(display, sent + 1);
+        first_return->sequence = sent + 2;
+    }
+    pthread_mutex_unlock(&dd->lock);
+    return ok ? count : 0;
+}
+
+u32
+XCBGetMaximumRequestLength(XCBDisplay *display)
+{
+    /* <Straight from the documentation.>
+     *
+     * In the absence of the BIG-REQUESTS extension, returns the
+     * maximum request length field from the connection setup data, which
+     * may be as much as 65535. If the server supports BIG-REQUESTS, then
+     * the maximum request length field from the reply to the
+     * BigRequestsEnable request will be returned instead.
+     *
+     * Note that this length is measured in four-byte units, making the
+     * theoretical maximum lengths roughly 256kB without BIG-REQUESTS and
+     * 16GB with.
+     */
+    return xcb_get_maximum_request_length(display);
+}
+
+int
+XCBCheckDisplayError(XCBDisplay *display)
+{   return xcb_connection_has_error(display);
+}
+int 
+XCBHasConnectionError(XCBDisplay *display)
+{   return xcb_connection_has_error(display);
+}
+int 
+XCBCheckConnectionError(XCBDisplay *display)
+{
+    return xcb_connection_has_error(display);
+}
+int 
+XCBHasDisplayError(XCBDisplay *display)
+{   return xcb_connection_has_error(display);
+}
+
+int
+XCBSetErrorHandler(void (*error_handler)(XCBDisplay *, XCBGenericError *))
+{   return !!(_handler = error_handler);
+}
+
+void
+XCBSetIOErrorHandler(XCBDisplay *display, XCBIOErrorHandler IOHandler)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   dd->io_handler = IOHandler;
+    }
+}
+
+char *
+XCBErrorCodeText(
+        uint8_t error_code)
+{
+    char *errs[18] =
+    {
+        [0] = NULL,
+        [BadRequest] = "BadRequest",
+        [BadValue] = "BadValue",
+        [BadWindow] = "BadWindow",
+        [BadPixmap] = "BadPixmap",
+        [BadAtom] = "BadAtom",
+        [BadCursor] = "BadCursor",
+        [BadFont] = "BadFont",
+        [BadMatch] = "BadMatch",
+        [BadDrawable] = "BadDrawable",
+        [BadAccess] = "BadAccess",
+        [BadAlloc] = "BadAlloc",
+        [BadColor] = "BadColor",
+        [BadGC] = "BadGC",
+        [BadIDChoice] = "BadIDChoice",
+        [BadName] = "BadName",
+        [BadLength] = "BadLength",
+        [BadImplementation] = "BadImplementation",
+    };
+    /* bounds check */      /* & over && for better inlining */
+    error_code *= (error_code > 0) & (error_code < 18);
+    return errs[error_code];
+}
+
+char *
+XCBErrorMajorCodeText(
+        uint8_t major_code)
+{
+    char *errs[128] = 
+    {
+        [0] = NULL,
+        [X_CreateWindow] = "CreateWindow",
+        [X_ChangeWindowAttributes] = "ChangeWindowAttributes",
+        [X_GetWindowAttributes] = "GetWindowAttributes",
+        [X_DestroyWindow] = "DestroyWindow",
+        [X_DestroySubwindows] = "DestroySubwindows",
+        [X_ChangeSaveSet] = "ChangeSaveSet",
+        [X_ReparentWindow] = "ReparentWindow",
+        [X_MapWindow] = "MapWindow",
+        [X_MapSubwindows] = "MapSubwindows",
+        [X_UnmapWindow] = "UnmapWindow",
+        [X_UnmapSubwindows] = "UnmapSubwindows",
+        [X_ConfigureWindow] = "ConfigureWindow",
+        [X_CirculateWindow] = "CirculateWindow",
+        [X_GetGeometry] = "GetGeometry",
+        [X_QueryTree] = "QueryTree",
+        [X_InternAtom] = "InternAtom",
+        [X_GetAtomName] = "GetAtomName",
+        [X_ChangeProperty] = "ChangeProperty",
+        [X_DeleteProperty] = "DeleteProperty",
+        [X_GetProperty] = "GetProperty",
         [X_ListProperties] = "ListProperties",
         [X_SetSelectionOwner] = "SetSelectionOwner",
         [X_GetSelectionOwner] = "GetSelectionOwner",
@@ -1114,169 +4621,2302 @@ XCBErrorMajorCodeText(
     return errs[major_code];
 }
 
-char *
-XCBErrorMinorCodeText(
-        uint16_t minor_code
+char *
+XCBErrorMinorCodeText(
+        uint16_t minor_code
+        )
+{   
+    return NULL;
+}
+
+char *
+XCBErrorDisplayText(
+        uint8_t display_error
+        )
+{
+    char *errs[7] = 
+    {
+        [0] = NULL,
+        [XCB_CONN_ERROR] = "DisplayError",
+        [XCB_CONN_CLOSED_EXT_NOTSUPPORTED] = "ExtensionNotSupported",
+        [XCB_CONN_CLOSED_MEM_INSUFFICIENT] = "OutOfMemory",
+        [XCB_CONN_CLOSED_REQ_LEN_EXCEED] = "TooManyRequests",
+        [XCB_CONN_CLOSED_PARSE_ERR] = "InvalidDisplay",
+        [XCB_CONN_CLOSED_INVALID_SCREEN] = "InvalidScreen"
+    };
+    /* bounds check */              /* & over && for better inlining */
+    display_error *= (display_error > 0) & (display_error < 7);
+    return errs[display_error];
+}
+
+
+
+/* events */
+
+
+
+XCBCookie
+XCBAllowEvents(XCBDisplay *display, u8 mode, XCBTimestamp tim)
+{
+#if DBG
+    XCBCookie cookie = xcb_allow_events_checked(display, mode, tim);
+    ck(display, cookie, _fn);
+    return cookie;
+#endif
+
+    return xcb_allow_events(display, mode, tim);
+}
+
+XCBCookie
+XCBSendEvent(
+        XCBDisplay *display,
+        XCBWindow window,
+        uint8_t propagate,
+        uint32_t event_mask,
+        const char *event
+        )
+{
+    _xcb_cfg_before(display);
+    return xcb_send_event(display, propagate, window, event_mask, event);
+}
+
+/* Reply callbacks.
+ * Replies arrive in sequence order, so only the oldest pending reply ever needs polling.
+ */
+static u64
+_xcb_widen(u64 last, u32 sequence)
+{
+    u64 full = (last & ~(u64)UINT32_MAX) | sequence;
+    if(full + 0x80000000ull < last)
+    {   full += (u64)1 << 32;
+    }
+    else if(full > last + 0x80000000ull && full > UINT32_MAX)
+    {   full -= (u64)1 << 32;
+    }
+    return full;
+}
+
+static void
+_xcb_sequence_return(void *closure)
+{
+}
+
+/* RETURN: The 64 bit sequence of the last request written, 32 bit cookies are widened against it until one is registered.
+ * RETURN: 0 on Failure (connection error).
+ */
+static u64
+_xcb_sequence(XCBDisplay *display)
+{
+    uint64_t sent = 0;
+    /* libxcb only ever hands the full sequence out with the socket, it is given back on the next request */
+    if(!xcb_take_socket(display, _xcb_sequence_return, NULL, 0, &sent))
+    {   return 0;
+    }
+    return sent;
+}
+
+static int
+_xcb_reply_push(_XCBReplyQueue *queue, u64 sequence, XCBReplyCallback callback, void *data)
+{
+    u32 i;
+    if(queue->len == queue->cap)
+    {
+        if(queue->head)
+        {   
+            memmove(queue->items, queue->items + queue->head, (queue->len - queue->head) * sizeof(_XCBPendingReply));
+            queue->len -= queue->head;
+            queue->head = 0;
+        }
+        else
+        {
+            const u32 cap = queue->cap ? queue->cap << 1 : 32;
+            _XCBPendingReply *items = realloc(queue->items, cap * sizeof(_XCBPendingReply));
+            if(!items)
+            {   return 0;
+            }
+            queue->items = items;
+            queue->cap = cap;
+        }
+    }
+    /* almost always the newest, so search from the back */
+    i = queue->len;
+    while(i > queue->head && queue->items[i - 1].sequence > sequence)
+    {   --i;
+    }
+    memmove(queue->items + i + 1, queue->items + i, (queue->len - i) * sizeof(_XCBPendingReply));
+    queue->items[i].sequence = sequence;
+    queue->items[i].callback = callback;
+    queue->items[i].data = data;
+    ++queue->len;
+    if(sequence > queue->last)
+    {   queue->last = sequence;
+    }
+    return 1;
+}
+
+static u32
+_xcb_reply_dispatch(XCBDisplay *display, _XCBReplyQueue *queue)
+{
+    _XCBPendingReply pending;
+    XCBGenericError *err;
+    void *reply;
+    u32 count = 0;
+
+    while(queue->head < queue->len)
+    {
+        reply = NULL;
+        err = NULL;
+        if(!xcb_poll_for_reply64(display, queue->items[queue->head].sequence, &reply, &err))
+        {   break;
+        }
+        /* pop before calling, callbacks may push */
+        pending = queue->items[queue->head++];
+        if(queue->head == queue->len)
+        {   queue->head = queue->len = 0;
+        }
+        if(err)
+        {
+            free(reply);
+            reply = NULL;
+        }
+        pending.callback(display, reply, err, pending.data);
+        free(err);
+        ++count;
+    }
+    return count;
+}
+
+/* Every event function goes through these, so anything that must happen while events are read lives here. */
+static XCBGenericEvent *
+_xcb_poll_event_raw(XCBDisplay *display, _XCBDisplayData *dd)
+{
+    XCBGenericEvent *ev = _xcb_ahead(dd);
+    if(ev)
+    {   return ev;
+    }
+    do
+    {
+        ev = dd && dd->reader ? _xcb_reader_next(display, dd, 0) : xcb_poll_for_event(display);
+        if(dd && dd->replies.len)
+        {   _xcb_reply_dispatch(display, &dd->replies);
+        }
+#ifdef DEFERRED_CK
+        if(dd)
+        {   ck_poll(display, &dd->checks);
+        }
+#endif
+        ev = _xcb_arrived(dd, ev);
+    } while(_xcb_err_routed(dd, ev));
+    return ev;
+}
+
+static XCBGenericEvent *
+_xcb_wait_event_read(XCBDisplay *display, _XCBDisplayData *dd)
+{
+    XCBGenericEvent *ev = _xcb_ahead(dd);
+    struct pollfd pfd;
+
+    if(ev)
+    {   return ev;
+    }
+    if(!dd || !dd->replies.len || dd->reader)
+    {   
+        if(dd && dd->reader)
+        {   
+            /* the reader thread owns the socket, replies are only checked for when events come in */
+            ev = _xcb_reader_next(display, dd, 1);
+            if(dd->replies.len)
+            {   _xcb_reply_dispatch(display, &dd->replies);
+            }
+        }
+        else
+        {   ev = xcb_wait_for_event(display);
+        }
+#ifdef DEFERRED_CK
+        /* anything before ev has completed by now */
+        if(dd)
+        {   ck_poll(display, &dd->checks);
+        }
+#endif
+        return _xcb_arrived(dd, ev);
+    }
+    /* xcb_wait_for_event() only wakes for events, so wait on the socket ourselves while replies are pending */
+    pfd.fd = xcb_get_file_descriptor(display);
+    pfd.events = POLLIN;
+    while(1)
+    {
+        ev = xcb_poll_for_event(display);
+        if(dd->replies.len && _xcb_reply_dispatch(display, &dd->replies))
+        {   
+            if(ev)
+            {   return _xcb_arrived(dd, ev);
+            }
+            continue;
+        }
+        if(!ev)
+        {   /* polling the reply may have read more events */
+            ev = xcb_poll_for_queued_event(display);
+        }
+        if(ev || xcb_connection_has_error(display))
+        {   return _xcb_arrived(dd, ev);
+        }
+        if(!dd->replies.len)
+        {   return _xcb_arrived(dd, xcb_wait_for_event(display));
+        }
+        xcb_flush(display);
+        poll(&pfd, 1, -1);
+    }
+}
+
+static XCBGenericEvent *
+_xcb_wait_event_raw(XCBDisplay *display, _XCBDisplayData *dd)
+{
+    XCBGenericEvent *ev;
+    /* an error the ring took is not an event, keep waiting */
+    do
+    {   ev = _xcb_wait_event_read(display, dd);
+    } while(_xcb_err_routed(dd, ev));
+    return ev;
+}
+
+/* Hands out the reduced batch, reading a new one once it runs dry.
+ * A batch is one event read normally plus everything xcb_poll_for_queued_event() has buffered after it.
+ */
+static XCBGenericEvent *
+_xcb_coalesce_next(XCBDisplay *display, _XCBDisplayData *dd, int block)
+{
+    _XCBCoalescer *co = &dd->coalesce;
+    XCBGenericEvent *ev;
+
+    while(1)
+    {
+        ev = _xcb_coalesce_pop(co);
+        if(ev)
+        {   return ev;
+        }
+        ev = block ? _xcb_wait_event_raw(display, dd) : _xcb_poll_event_raw(display, dd);
+        if(!ev || !co->enabled)
+        {   return ev;
+        }
+        do
+        {
+            if(!_xcb_coalesce_feed(co, ev))
+            {   
+                /* out of memory, there is nowhere to put it without reordering */
+                free(ev);
+            }
+        } while((ev = _xcb_queued_event(display, dd)));
+
+        /* everything may have been held back (Expose's), so only a blocking read keeps going */
+        if(!block && co->head == co->len)
+        {   return NULL;
+        }
+    }
+}
+
+/* Calls the IO error handler the first time the connection is seen broken.
+ *
+ * RETURN: XCBHasConnectionError() code.
+ */
+static int
+_xcb_io_check(XCBDisplay *display, _XCBDisplayData *dd)
+{
+    const int err = xcb_connection_has_error(display);
+    if(err && dd && !dd->io_reported)
+    {
+        dd->io_reported = 1;
+        if(dd->io_handler)
+        {   dd->io_handler(display, err);
+        }
+    }
+    return err;
+}
+
+/* Fetches the state of count windows in 1 round trip.
+ *
+ * states_return:   Filled per window, windows that are gone get an override_redirect of UINT8_MAX.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+static int
+_xcb_mirror_fetch(XCBDisplay *display, const XCBWindow *windows, u32 count, XCBWindowState *states_return)
+{
+    xcb_get_window_attributes_reply_t *attr;
+    xcb_get_geometry_reply_t *geom;
+    XCBGenericError *err;
+    u32 *cookies = malloc(count * 2 * sizeof(u32));
+    u32 i;
+    if(!cookies)
+    {   return 0;
+    }
+    _xcb_cfg_before(display);
+    for(i = 0; i < count; ++i)
+    {
+        cookies[i * 2] = xcb_get_window_attributes(display, windows[i]).sequence;
+        cookies[i * 2 + 1] = xcb_get_geometry(display, windows[i]).sequence;
+    }
+    for(i = 0; i < count; ++i)
+    {
+        err = NULL;
+        attr = xcb_get_window_attributes_reply(display, (xcb_get_window_attributes_cookie_t){ .sequence = cookies[i * 2] }, &err);
+        free(err);
+        err = NULL;
+        geom = xcb_get_geometry_reply(display, (xcb_get_geometry_cookie_t){ .sequence = cookies[i * 2 + 1] }, &err);
+        free(err);
+        memset(&states_return[i], 0, sizeof(XCBWindowState));
+        if(attr && geom)
+        {
+            states_return[i].x = geom->x;
+            states_return[i].y = geom->y;
+            states_return[i].width = geom->width;
+            states_return[i].height = geom->height;
+            states_return[i].border_width = geom->border_width;
+            states_return[i].map_state = attr->map_state;
+            states_return[i].override_redirect = attr->override_redirect;
+        }
+        else
+        {   states_return[i].override_redirect = UINT8_MAX;
+        }
+        free(attr);
+        free(geom);
+    }
+    free(cookies);
+    return 1;
+}
+
+/* RETURN: Number of windows that differed, -1 on Failure (or skipped because events were left). */
+static int
+_xcb_mirror_verify(XCBDisplay *display, _XCBDisplayData *dd, int report)
+{
+    _XCBMirror *mirror = &dd->mirror;
+    XCBWindowState *states;
+    XCBWindowState *state;
+    XCBWindow *windows;
+    XCBGenericEvent *ev = NULL;
+    u32 count;
+    u32 i;
+    int diff = -1;
+
+    /* the reader thread owns the queue, and anything queued would not be reflected yet */
+    if(!mirror->enabled || dd->reader || dd->coalesce.head < dd->coalesce.len || (ev = _xcb_queued_event(display, dd)))
+    {
+        if(ev)
+        {   dd->ahead = ev;
+        }
+        return -1;
+    }
+    windows = malloc((mirror->windows.len + 1) * sizeof(XCBWindow));
+    states = malloc((mirror->windows.len + 1) * sizeof(XCBWindowState));
+    if(!windows || !states)
+    {   goto CLEANUP;
+    }
+    for(i = count = 0; i < mirror->windows.cap; ++i)
+    {
+        if(mirror->windows.keys[i] && mirror->windows.keys[i] != _XCB_MAP_TOMB)
+        {   windows[count++] = mirror->windows.keys[i];
+        }
+    }
+    if(!_xcb_mirror_fetch(display, windows, count, states))
+    {   goto CLEANUP;
+    }
+    /* events that came in before the replies change what the mirror should be, put them back and try again later */
+    if((ev = _xcb_queued_event(display, dd)))
+    {
+        dd->ahead = ev;
+        goto CLEANUP;
+    }
+    diff = 0;
+    for(i = 0; i < count; ++i)
+    {
+        state = _xcb_mirror_get(mirror, windows[i]);
+        if(states[i].override_redirect == UINT8_MAX)
+        {
+            if(report)
+            {   fprintf(stderr, "Mirror: window %u no longer exists.\n", windows[i]);
+            }
+            _xcb_mirror_del(mirror, windows[i]);
+            ++diff;
+            continue;
+        }
+        /* QueryTree is the only source for parent, it is left as is */
+        states[i].parent = state->parent;
+        if(memcmp(state, &states[i], sizeof(XCBWindowState)))
+        {
+            if(report)
+            {   
+                fprintf(stderr, "Mirror: window %u is %d,%d %ux%u+%u map_state %u, mirror has %d,%d %ux%u+%u map_state %u.\n", windows[i],
+                        states[i].x, states[i].y, states[i].width, states[i].height, states[i].border_width, states[i].map_state,
+                        state->x, state->y, state->width, state->height, state->border_width, state->map_state);
+            }
+            *state = states[i];
+            ++diff;
+        }
+    }
+CLEANUP:
+    free(windows);
+    free(states);
+    return diff;
+}
+
+static XCBGenericEvent *
+_xcb_poll_event(XCBDisplay *display)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    XCBGenericEvent *ev;
+    if(dd && (dd->coalesce.enabled || dd->coalesce.head < dd->coalesce.len))
+    {   ev = _xcb_coalesce_next(display, dd, 0);
+    }
+    else
+    {   ev = _xcb_poll_event_raw(display, dd);
+    }
+    if(!ev)
+    {   _xcb_io_check(display, dd);
+    }
+    return ev;
+}
+
+static XCBGenericEvent *
+_xcb_wait_event(XCBDisplay *display)
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    XCBGenericEvent *ev;
+    if(dd && (dd->coalesce.enabled || dd->coalesce.head < dd->coalesce.len))
+    {   ev = _xcb_coalesce_next(display, dd, 1);
+    }
+    else
+    {   ev = _xcb_wait_event_raw(display, dd);
+    }
+    if(!ev)
+    {   _xcb_io_check(display, dd);
+    }
+    return ev;
+}
+
+/* Next event without blocking, first reads the connection, after that only what is already queued is taken. */
+static XCBGenericEvent *
+_xcb_poll_next(XCBDisplay *display, _XCBDisplayData *dd, int first)
+{
+    if(first || (dd && (dd->coalesce.enabled || dd->coalesce.head < dd->coalesce.len)))
+    {   return _xcb_poll_event(display);
+    }
+    return _xcb_queued_event(display, dd);
+}
+
+/* Copies the payload of a GenericEvent in slot.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+static int
+_xcb_payload_push(_XCBPayloads *pl, u32 slot, const XCBGeEvent *ge)
+{
+    const u32 size = ge->length * 4;
+    u32 cap;
+    void *p;
+
+    if(pl->size + size > pl->cap)
+    {
+        cap = pl->cap ? pl->cap : 1024;
+        while(cap < pl->size + size)
+        {   cap <<= 1;
+        }
+        p = realloc(pl->data, cap);
+        if(!p)
+        {   return 0;
+        }
+        pl->data = p;
+        pl->cap = cap;
+    }
+    if(pl->len == pl->index_cap)
+    {
+        cap = pl->index_cap ? pl->index_cap << 1 : 16;
+        p = realloc(pl->index, cap * 2 * sizeof(u32));
+        if(!p)
+        {   return 0;
+        }
+        pl->index = p;
+        pl->index_cap = cap;
+    }
+    /* libxcb moves the payload behind full_sequence */
+    memcpy(pl->data + pl->size, (const u8 *)ge + sizeof(XCBGeEvent), size);
+    pl->index[pl->len * 2] = slot;
+    pl->index[pl->len * 2 + 1] = pl->size;
+    ++pl->len;
+    pl->size += size;
+    return 1;
+}
+
+uint32_t
+XCBPollForEvents(
+        XCBDisplay *display,
+        XCBGenericEvent *events_return,
+        uint32_t max
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    XCBGenericEvent *ev;
+    u32 i;
+
+    if(dd)
+    {   dd->payloads.size = dd->payloads.len = 0;
+    }
+    for(i = 0; i < max; ++i)
+    {
+        ev = _xcb_poll_next(display, dd, !i);
+        if(!ev)
+        {   break;
+        }
+        events_return[i] = *ev;
+        /* out of memory just leaves it without a payload, XCBGetEventPayload() reports that */
+        if((ev->response_type & 0x7f) == XCB_GE_GENERIC && ((XCBGeEvent *)ev)->length && dd)
+        {   _xcb_payload_push(&dd->payloads, i, (XCBGeEvent *)ev);
+        }
+        free(ev);
+    }
+    return i;
+}
+
+const void *
+XCBGetEventPayload(
+        XCBDisplay *display,
+        uint32_t index
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    u32 lo;
+    u32 hi;
+    u32 mid;
+    if(!dd)
+    {   return NULL;
+    }
+    lo = 0;
+    hi = dd->payloads.len;
+    while(lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if(dd->payloads.index[mid * 2] < index)
+        {   lo = mid + 1;
+        }
+        else
+        {   hi = mid;
+        }
+    }
+    if(lo < dd->payloads.len && dd->payloads.index[lo * 2] == index)
+    {   return dd->payloads.data + dd->payloads.index[lo * 2 + 1];
+    }
+    return NULL;
+}
+
+int
+XCBSetEventCoalescing(
+        XCBDisplay *display,
+        int enable
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBCoalescer *co;
+    XCBExposeEvent *expose;
+    u32 i;
+    if(!dd)
+    {   return 0;
+    }
+    co = &dd->coalesce;
+    co->enabled = !!enable;
+    if(!co->enabled)
+    {
+        /* release anything still being unioned so it isnt stuck behind a count that already went by */
+        for(i = 0; i < co->exposes.cap; ++i)
+        {
+            if(co->exposes.keys[i] && co->exposes.keys[i] != _XCB_MAP_TOMB)
+            {
+                expose = co->exposes.vals[i];
+                expose->count = 0;
+                if(!_xcb_coalesce_append(co, (XCBGenericEvent *)expose))
+                {   free(expose);
+                }
+            }
+        }
+        _xcb_map_clear(&co->exposes);
+    }
+    return 1;
+}
+
+int
+XCBSetConfigureCache(
+        XCBDisplay *display,
+        int enable
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd)
+    {   return 0;
+    }
+    if(!enable && dd->configs.enabled)
+    {
+        _xcb_cfg_flush(display, &dd->configs);
+        _xcb_cfg_wipe(&dd->configs);
+    }
+    dd->configs.enabled = !!enable;
+    return 1;
+}
+
+int
+XCBMirrorWindows(
+        XCBDisplay *display,
+        XCBWindow root
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    xcb_query_tree_reply_t *tree;
+    XCBGenericError *err = NULL;
+    XCBWindowState *states = NULL;
+    XCBWindowState *state;
+    XCBWindow *windows = NULL;
+    u32 count;
+    u32 i;
+    int ret = 0;
+
+    if(!dd)
+    {   return 0;
+    }
+    _xcb_mirror_wipe(&dd->mirror);
+    _xcb_cfg_before(display);
+    tree = xcb_query_tree_reply(display, xcb_query_tree(display, root), &err);
+    if(!tree)
+    {   
+        free(err);
+        return 0;
+    }
+    count = xcb_query_tree_children_length(tree) + 1;
+    windows = malloc(count * sizeof(XCBWindow));
+    states = malloc(count * sizeof(XCBWindowState));
+    if(!windows || !states)
+    {   goto CLEANUP;
+    }
+    windows[0] = root;
+    memcpy(windows + 1, xcb_query_tree_children(tree), (count - 1) * sizeof(XCBWindow));
+    if(!_xcb_mirror_fetch(display, windows, count, states))
+    {   goto CLEANUP;
+    }
+    for(i = 0; i < count; ++i)
+    {
+        /* gone already, its DestroyNotify is still on the way */
+        if(states[i].override_redirect == UINT8_MAX)
+        {   continue;
+        }
+        state = _xcb_mirror_add(&dd->mirror, windows[i]);
+        if(!state)
+        {   
+            _xcb_mirror_wipe(&dd->mirror);
+            goto CLEANUP;
+        }
+        *state = states[i];
+        state->parent = i ? root : tree->parent;
+    }
+    dd->mirror.enabled = 1;
+    ret = 1;
+CLEANUP:
+    free(tree);
+    free(windows);
+    free(states);
+    return ret;
+}
+
+void
+XCBStopMirror(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   _xcb_mirror_wipe(&dd->mirror);
+    }
+}
+
+int
+XCBMirrorLookup(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBWindowState *state_return
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    XCBWindowState *state = dd ? _xcb_mirror_get(&dd->mirror, window) : NULL;
+    if(!state)
+    {   return 0;
+    }
+    *state_return = *state;
+    return 1;
+}
+
+int
+XCBMirrorVerify(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    return dd ? _xcb_mirror_verify(display, dd, 0) : -1;
+}
+
+void
+XCBSetMirrorSelfCheck(
+        XCBDisplay *display,
+        uint32_t interval_ms
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   
+        dd->mirror.interval = interval_ms;
+        dd->mirror.checked = _xcb_time_ms();
+    }
+}
+
+static int
+_xcb_edge_cmp(const void *a, const void *b)
+{
+    const i32 x = *(const i32 *)a;
+    const i32 y = *(const i32 *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorts and dedups edges in place.
+ *
+ * RETURN: Number of distinct edges.
+ */
+static u32
+_xcb_edges_unique(i32 *edges, u32 len)
+{
+    u32 i;
+    u32 j = 0;
+    qsort(edges, len, sizeof(i32), _xcb_edge_cmp);
+    for(i = 1; i < len; ++i)
+    {
+        if(edges[i] != edges[j])
+        {   edges[++j] = edges[i];
+        }
+    }
+    return len ? j + 1 : 0;
+}
+
+/* RETURN: Index of the cell [edges[i], edges[i + 1]) holding v, -1 if outside all of them. */
+static i32
+_xcb_edges_find(const i32 *edges, u32 len, i32 v)
+{
+    u32 lo = 0;
+    u32 hi = len;
+    u32 mid;
+    /* first edge past v */
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(edges[mid] <= v)
+        {   lo = mid + 1;
+        }
+        else
+        {   hi = mid;
+        }
+    }
+    return lo && lo < len ? (i32)lo - 1 : -1;
+}
+
+static _XCBMonitorSet *
+_xcb_monitors_build(const XCBMonitor *monitors, u32 count, u8 source, u32 serial)
+{
+    _XCBMonitorSet *set;
+    XCBMonitor *copy;
+    i32 x0, x1, y0, y1;
+    i32 r, c;
+    u32 cells;
+    u32 i;
+
+    /* at most 2 edges per monitor a side, so at most (2 * count - 1) ^ 2 cells */
+    cells = (2 * count) * (2 * count);
+    set = malloc(sizeof(_XCBMonitorSet) + count * sizeof(XCBMonitor) + 4 * count * sizeof(i32) + cells * sizeof(i16));
+    if(!set)
+    {   return NULL;
+    }
+    copy = (XCBMonitor *)(set + 1);
+    set->xs = (i32 *)(copy + count);
+    set->ys = set->xs + 2 * count;
+    set->cells = (i16 *)(set->ys + 2 * count);
+    memcpy(copy, monitors, count * sizeof(XCBMonitor));
+    for(i = 0; i < count; ++i)
+    {
+        set->xs[2 * i] = monitors[i].x;
+        set->xs[2 * i + 1] = monitors[i].x + monitors[i].width;
+        set->ys[2 * i] = monitors[i].y;
+        set->ys[2 * i + 1] = monitors[i].y + monitors[i].height;
+    }
+    set->nx = _xcb_edges_unique(set->xs, 2 * count);
+    set->ny = _xcb_edges_unique(set->ys, 2 * count);
+    if(set->nx > 1 && set->ny > 1)
+    {   memset(set->cells, 0xff, (set->nx - 1) * (set->ny - 1) * sizeof(i16));
+    }
+    for(i = count; i-- > 0; )
+    {
+        /* filled last to first, so the first monitor covering a cell (clones) owns it */
+        x0 = _xcb_edges_find(set->xs, set->nx, monitors[i].x);
+        x1 = _xcb_edges_find(set->xs, set->nx, monitors[i].x + monitors[i].width);
+        y0 = _xcb_edges_find(set->ys, set->ny, monitors[i].y);
+        y1 = _xcb_edges_find(set->ys, set->ny, monitors[i].y + monitors[i].height);
+        /* the far edges are the last edge found, or the edge starting the cell just past the monitor */
+        x1 = x1 < 0 ? (i32)set->nx - 1 : x1;
+        y1 = y1 < 0 ? (i32)set->ny - 1 : y1;
+        for(r = y0; r >= 0 && r < y1; ++r)
+        {
+            for(c = x0; c >= 0 && c < x1; ++c)
+            {   set->cells[r * (set->nx - 1) + c] = i;
+            }
+        }
+    }
+    set->pub.count = count;
+    set->pub.serial = serial;
+    set->pub.source = source;
+    set->pub.monitors = copy;
+    return set;
+}
+
+/* Fetches the monitors in 1 round: RandR 1.5 GetMonitors, else Xinerama, else the screen of root.
+ *
+ * randr_only:          Skip Xinerama, the last fetch got its monitors from RandR.
+ * randr_minor_return:  RandR 1.x minor version, -1 without RandR.
+ *
+ * RETURN: _XCBMonitorSet * on Success.
+ * RETURN: NULL on Failure.
+ */
+static _XCBMonitorSet *
+_xcb_monitors_fetch(XCBDisplay *display, XCBWindow root, u32 serial, int randr_only, int *randr_minor_return)
+{
+    const xcb_query_extension_reply_t *randr;
+    const xcb_query_extension_reply_t *xinerama;
+    xcb_randr_query_version_cookie_t version_cookie = { 0 };
+    xcb_randr_get_monitors_cookie_t monitors_cookie = { 0 };
+    xcb_xinerama_is_active_cookie_t active_cookie = { 0 };
+    xcb_xinerama_query_screens_cookie_t screens_cookie = { 0 };
+    xcb_randr_query_version_reply_t *version = NULL;
+    xcb_randr_get_monitors_reply_t *rr = NULL;
+    xcb_xinerama_is_active_reply_t *active = NULL;
+    xcb_xinerama_query_screens_reply_t *xr = NULL;
+    xcb_randr_monitor_info_iterator_t it;
+    const xcb_xinerama_screen_info_t *info;
+    xcb_get_geometry_reply_t *geometry = NULL;
+    XCBGenericError *err = NULL;
+    XCBMonitor *monitors = NULL;
+    _XCBMonitorSet *set = NULL;
+    u8 source = XCB_MONITORS_SCREEN;
+    u32 count = 0;
+    u32 len;
+    u32 i;
+    u32 j;
+
+    /* both QueryExtension go out together, xcb keeps the answers for later rebuilds */
+    xcb_prefetch_extension_data(display, &xcb_randr_id);
+    if(!randr_only)
+    {   xcb_prefetch_extension_data(display, &xcb_xinerama_id);
+    }
+    randr = xcb_get_extension_data(display, &xcb_randr_id);
+    xinerama = randr_only ? NULL : xcb_get_extension_data(display, &xcb_xinerama_id);
+    /* GetMonitors is sent before the version is known, an older server just errors it */
+    if(randr && randr->present)
+    {
+        version_cookie = xcb_randr_query_version(display, 1, 5);
+        monitors_cookie = xcb_randr_get_monitors(display, root, 1);
+    }
+    if(xinerama && xinerama->present)
+    {
+        active_cookie = xcb_xinerama_is_active(display);
+        screens_cookie = xcb_xinerama_query_screens(display);
+    }
+    if(randr && randr->present)
+    {
+        version = xcb_randr_query_version_reply(display, version_cookie, &err);
+        free(err);
+        err = NULL;
+        rr = xcb_randr_get_monitors_reply(display, monitors_cookie, &err);
+        free(err);
+        err = NULL;
+    }
+    if(xinerama && xinerama->present)
+    {
+        active = xcb_xinerama_is_active_reply(display, active_cookie, &err);
+        free(err);
+        err = NULL;
+        xr = xcb_xinerama_query_screens_reply(display, screens_cookie, &err);
+        free(err);
+        err = NULL;
+    }
+    *randr_minor_return = version && version->major_version == 1 ? (int)version->minor_version : -1;
+
+    if(version && (version->major_version > 1 || version->minor_version >= 5) && rr && rr->nMonitors)
+    {
+        monitors = malloc(rr->nMonitors * sizeof(XCBMonitor));
+        if(!monitors)
+        {   goto CLEANUP;
+        }
+        for(it = xcb_randr_get_monitors_monitors_iterator(rr); it.rem; xcb_randr_monitor_info_next(&it))
+        {
+            monitors[count++] = (XCBMonitor)
+            {   .x = it.data->x, .y = it.data->y, .width = it.data->width, .height = it.data->height,
+                .name = it.data->name, .primary = it.data->primary
+            };
+        }
+        source = XCB_MONITORS_RANDR;
+    }
+    else if(active && active->state && xr && (len = xcb_xinerama_query_screens_screen_info_length(xr)))
+    {
+        monitors = malloc(len * sizeof(XCBMonitor));
+        if(!monitors)
+        {   goto CLEANUP;
+        }
+        info = xcb_xinerama_query_screens_screen_info(xr);
+        for(i = 0; i < len; ++i)
+        {
+            /* clones come as the same rectangle more than once */
+            for(j = 0; j < count; ++j)
+            {
+                if(monitors[j].x == info[i].x_org && monitors[j].y == info[i].y_org 
+                && monitors[j].width == info[i].width && monitors[j].height == info[i].height)
+                {   break;
+                }
+            }
+            if(j == count)
+            {
+                monitors[count] = (XCBMonitor)
+                {   .x = info[i].x_org, .y = info[i].y_org, .width = info[i].width, .height = info[i].height,
+                    .primary = !count
+                };
+                ++count;
+            }
+        }
+        source = XCB_MONITORS_XINERAMA;
+    }
+    if(!count)
+    {
+        free(monitors);
+        monitors = malloc(sizeof(XCBMonitor));
+        geometry = xcb_get_geometry_reply(display, xcb_get_geometry(display, root), &err);
+        if(err)
+        {   _xcb_err_handler(display, err);
+        }
+        if(!monitors || !geometry)
+        {   goto CLEANUP;
+        }
+        monitors[count++] = (XCBMonitor) { .width = geometry->width, .height = geometry->height, .primary = 1 };
+        source = XCB_MONITORS_SCREEN;
+    }
+    set = _xcb_monitors_build(monitors, count, source, serial);
+CLEANUP:
+    free(version);
+    free(rr);
+    free(active);
+    free(xr);
+    free(geometry);
+    free(monitors);
+    return set;
+}
+
+int
+XCBTrackMonitors(
+        XCBDisplay *display,
+        XCBWindow root
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    const xcb_query_extension_reply_t *randr;
+    _XCBMonitorSet *set;
+    u16 mask = XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE;
+    int minor;
+    if(!dd)
+    {   return 0;
+    }
+    _xcb_monitors_wipe(&dd->monitors);
+    set = _xcb_monitors_fetch(display, root, 1, 0, &minor);
+    if(!set)
+    {   return 0;
+    }
+    randr = xcb_get_extension_data(display, &xcb_randr_id);
+    if(minor >= 0)
+    {
+        /* output and crtc changes only exist since 1.2 */
+        if(minor >= 2)
+        {   mask |= XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE | XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE;
+        }
+#ifdef DBG
+        ck(display, xcb_randr_select_input_checked(display, root, mask), _fn);
+#else
+        xcb_randr_select_input(display, root, mask);
+#endif
+        dd->monitors.first_event = randr->first_event;
+    }
+    dd->monitors.current = set;
+    dd->monitors.root = root;
+    dd->monitors.serial = 1;
+    dd->monitors.enabled = 1;
+    return 1;
+}
+
+void
+XCBStopMonitors(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   _xcb_monitors_wipe(&dd->monitors);
+    }
+}
+
+const XCBMonitors *
+XCBGetMonitors(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd || !dd->monitors.enabled)
+    {   return NULL;
+    }
+    return &dd->monitors.current->pub;
+}
+
+int
+XCBRefreshMonitors(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBMonitorCache *mc;
+    _XCBMonitorSet *set;
+    int minor;
+    if(!dd || !dd->monitors.enabled)
+    {   return 0;
+    }
+    mc = &dd->monitors;
+    if(!mc->dirty)
+    {   return 1;
+    }
+    /* on failure the old snapshot is kept, and fetched again next time */
+    set = _xcb_monitors_fetch(display, mc->root, mc->serial + 1, mc->current->pub.source == XCB_MONITORS_RANDR, &minor);
+    if(!set)
+    {   return 0;
+    }
+    free(mc->current);
+    mc->current = set;
+    ++mc->serial;
+    mc->dirty = 0;
+    return 1;
+}
+
+int
+XCBMonitorsChanged(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    return dd && dd->monitors.enabled && dd->monitors.dirty;
+}
+
+int
+XCBMonitorAtPoint(
+        const XCBMonitors *monitors,
+        i16 x,
+        i16 y
+        )
+{
+    /* pub is the first member, monitors is only ever handed out from a set */
+    const _XCBMonitorSet *set = (const _XCBMonitorSet *)monitors;
+    i32 c;
+    i32 r;
+    if(!set)
+    {   return -1;
+    }
+    c = _xcb_edges_find(set->xs, set->nx, x);
+    r = _xcb_edges_find(set->ys, set->ny, y);
+    if(c < 0 || r < 0)
+    {   return -1;
+    }
+    return set->cells[r * (set->nx - 1) + c];
+}
+
+int
+XCBMonitorForRect(
+        const XCBMonitors *monitors,
+        i16 x,
+        i16 y,
+        u16 width,
+        u16 height
+        )
+{
+    const _XCBMonitorSet *set = (const _XCBMonitorSet *)monitors;
+    const XCBMonitor *m;
+    i64 area;
+    i64 best_area = 0;
+    i32 w;
+    i32 h;
+    i32 c;
+    i32 r;
+    int best = -1;
+    u32 i;
+    if(!set)
+    {   return -1;
+    }
+    /* the usual case, the rect is all on the monitor its centre is on */
+    c = _xcb_edges_find(set->xs, set->nx, x + width / 2);
+    r = _xcb_edges_find(set->ys, set->ny, y + height / 2);
+    if(c >= 0 && r >= 0 && (best = set->cells[r * (set->nx - 1) + c]) >= 0)
+    {
+        m = set->pub.monitors + best;
+        if(x >= m->x && y >= m->y && x + width <= m->x + m->width && y + height <= m->y + m->height)
+        {   return best;
+        }
+    }
+    best = -1;
+    for(i = 0; i < set->pub.count; ++i)
+    {
+        m = set->pub.monitors + i;
+        w = (x + width < m->x + m->width ? x + width : m->x + m->width) - (x > m->x ? x : m->x);
+        h = (y + height < m->y + m->height ? y + height : m->y + m->height) - (y > m->y ? y : m->y);
+        area = w > 0 && h > 0 ? (i64)w * h : 0;
+        if(area > best_area)
+        {
+            best_area = area;
+            best = i;
+        }
+    }
+    return best;
+}
+
+int
+XCBStartEventThread(
+        XCBDisplay *display,
+        uint32_t size
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBReader *rd;
+    u32 cap = 64;
+
+    if(!dd || xcb_connection_has_error(display))
+    {   return 0;
+    }
+    if(dd->reader)
+    {   /* still running, or stopped with events left to hand out */
+        return !dd->reader->stopping;
+    }
+    size = size ? size : 1024;
+    while(cap < size && cap < (1u << 31))
+    {   cap <<= 1;
+    }
+    rd = calloc(1, sizeof(_XCBReader));
+    if(!rd)
+    {   return 0;
+    }
+    rd->ring = malloc(cap * sizeof(XCBGenericEvent *));
+    rd->mask = cap - 1;
+    rd->ready = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    rd->space = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    rd->display = display;
+    if(!rd->ring || rd->ready < 0 || rd->space < 0)
+    {   goto FAILURE;
+    }
+    rd->window = xcb_generate_id(display);
+    xcb_create_window(display, XCB_COPY_FROM_PARENT, rd->window, XCBRootWindow(display, 0), 
+            -1, -1, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, NULL);
+    xcb_flush(display);
+    if(pthread_create(&rd->thread, NULL, _xcb_reader_main, rd))
+    {   
+        xcb_destroy_window(display, rd->window);
+        goto FAILURE;
+    }
+    dd->reader = rd;
+    ++dd->readers;
+    return 1;
+FAILURE:
+    if(rd->ready >= 0)
+    {   close(rd->ready);
+    }
+    if(rd->space >= 0)
+    {   close(rd->space);
+    }
+    free(rd->ring);
+    free(rd);
+    return 0;
+}
+
+void
+XCBStopEventThread(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd || !dd->reader)
+    {   return;
+    }
+    _xcb_reader_stop(display, dd->reader);
+    /* anything it read is still handed out first, the rest is freed once that runs out */
+    if(dd->reader->stash_head == dd->reader->stash_len && atomic_load(&dd->reader->head) == atomic_load(&dd->reader->tail))
+    {   _xcb_reader_free(display, dd);
+    }
+}
+
+int
+XCBEventThreadFd(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    return dd && dd->reader ? dd->reader->ready : -1;
+}
+
+void
+XCBGetCoalesceStats(
+        XCBDisplay *display,
+        XCBCoalesceStats *stats_return
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(dd)
+    {   *stats_return = dd->coalesce.stats;
+    }
+    else
+    {   memset(stats_return, 0, sizeof(XCBCoalesceStats));
+    }
+}
+
+int
+XCBSetReplyCallback64(
+        XCBDisplay *display,
+        XCBCookie64 cookie,
+        XCBReplyCallback callback,
+        void *data
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd || !_xcb_reply_push(&dd->replies, cookie.sequence, callback, data))
+    {
+        xcb_discard_reply64(display, cookie.sequence);
+        return 0;
+    }
+    return 1;
+}
+
+int
+XCBSetReplyCallback(
+        XCBDisplay *display,
+        XCBCookie cookie,
+        XCBReplyCallback callback,
+        void *data
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd)
+    {   
+        xcb_discard_reply(display, cookie.sequence);
+        return 0;
+    }
+    /* nothing to widen against yet, the connection may be past 2^32 requests already */
+    if(!dd->replies.last)
+    {   dd->replies.last = _xcb_sequence(display);
+    }
+    return XCBSetReplyCallback64(display, (XCBCookie64) { .sequence = _xcb_widen(dd->replies.last, cookie.sequence) }, callback, data);
+}
+
+int
+XCBCancelReplyCallback(
+        XCBDisplay *display,
+        XCBCookie cookie
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBReplyQueue *queue;
+    u64 sequence;
+    u32 i;
+    if(!dd)
+    {   return 0;
+    }
+    queue = &dd->replies;
+    sequence = _xcb_widen(queue->last, cookie.sequence);
+    for(i = queue->head; i < queue->len; ++i)
+    {
+        if(queue->items[i].sequence == sequence)
+        {
+            memmove(queue->items + i, queue->items + i + 1, (queue->len - i - 1) * sizeof(_XCBPendingReply));
+            if(--queue->len == queue->head)
+            {   queue->head = queue->len = 0;
+            }
+            xcb_discard_reply64(display, sequence);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+u32
+XCBDispatchReplies(
+        XCBDisplay *display
+        )
+{
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd || !dd->replies.len)
+    {   return 0;
+    }
+    return _xcb_reply_dispatch(display, &dd->replies);
+}
+
+int 
+XCBNextEvent(XCBDisplay *display, XCBGenericEvent **event_return) 
+{
+    /* waits till next event happens before returning */
+    return !!(*event_return = _xcb_wait_event(display));
+}
+
+XCBGenericEvent *
+XCBWaitForEvent(XCBDisplay *display)
+{
+    /* waits till next event happens before returning */
+    return _xcb_wait_event(display);
+}
+
+XCBGenericEvent *
+XCBPollForEvent(XCBDisplay *display)
+{
+    /* TODO */
+    /* If I/O error do something */
+   return _xcb_poll_event(display);
+}
+
+XCBGenericEvent *
+XCBPollForQueuedEvent(XCBDisplay *display)
+{
+    return _xcb_queued_event(display, _xcb_dpy(display));
+}
+
+void *
+XCBCheckReply(
+        XCBDisplay *display, 
+        XCBCookie request)
+{
+    XCBGenericError *err = NULL;
+    void *reply = NULL;
+    xcb_poll_for_reply(display, request.sequence, &reply, &err);
+
+    if(err)
+    {    
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+void *
+XCBCheckReply64(
+        XCBDisplay *display, 
+        XCBCookie64 request)
+{   
+    XCBGenericError *err = NULL;
+    void *reply = NULL;
+    xcb_poll_for_reply64(display, request.sequence, &reply, &err);
+
+    if(err)
+    {    
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+
+void *
+XCBWaitForReply(
+        XCBDisplay *display,
+        XCBCookie cookie
+        )
+{
+    XCBGenericError *err = NULL;
+    void *reply = xcb_wait_for_reply(display, cookie.sequence, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+void *
+XCBWaitForReply64(
+        XCBDisplay *display,
+        XCBCookie64 cookie
+        )
+{
+    XCBGenericError *err = NULL;
+    void *reply = xcb_wait_for_reply64(display, cookie.sequence, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+/* Batches.
+ * Cookies are kept in sequence order so draining never waits on a reply behind one we havent read yet.
+ */
+typedef struct _XCBBatchSlot _XCBBatchSlot;
+
+struct _XCBBatchSlot
+{
+    u32 sequence;
+    void **reply;
+    XCBGenericError *error;
+};
+
+typedef struct _XCBLoopSource _XCBLoopSource;
+
+struct _XCBLoopSource
+{
+    int fd;
+    u8 timer;
+    u8 dead;            /* removed while dispatching, freed once it is done */
+    XCBEventLoopFdCallback on_fd;
+    XCBEventLoopTimerCallback on_timer;
+    void *data;
+    _XCBLoopSource *next;
+};
+
+struct XCBEventLoop
+{
+    XCBDisplay *display;
+    XCBEventLoopEventCallback callback;
+    void *data;
+    _XCBLoopSource *sources;
+    int epfd;
+    int fd;             /* connection, or the eventfd of the reader thread while it runs */
+    u32 source;         /* 0 for the connection, else _XCBDisplayData.readers of the reader fd belongs to */
+    u8 stop;
+    u8 dispatching;
+};
+
+XCBEventLoop *
+XCBCreateEventLoop(
+        XCBDisplay *display,
+        XCBEventLoopEventCallback callback,
+        void *data
+        )
+{
+    XCBEventLoop *loop = calloc(1, sizeof(XCBEventLoop));
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if(!loop)
+    {   return NULL;
+    }
+    loop->display = display;
+    loop->callback = callback;
+    loop->data = data;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->fd = xcb_get_file_descriptor(display);
+    /* the connection is the only source with a NULL ptr */
+    if(loop->epfd < 0 || epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->fd, &ev) < 0)
+    {
+        if(loop->epfd >= 0)
+        {   close(loop->epfd);
+        }
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void
+XCBFreeEventLoop(
+        XCBEventLoop *loop
+        )
+{
+    _XCBLoopSource *src;
+    if(!loop)
+    {   return;
+    }
+    while((src = loop->sources))
+    {
+        loop->sources = src->next;
+        if(src->timer && !src->dead)
+        {   close(src->fd);
+        }
+        free(src);
+    }
+    close(loop->epfd);
+    free(loop);
+}
+
+XCBDisplay *
+XCBEventLoopDisplay(
+        XCBEventLoop *loop
+        )
+{   return loop->display;
+}
+
+static _XCBLoopSource *
+_xcb_loop_add(XCBEventLoop *loop, int fd, uint32_t events, u8 timer)
+{
+    _XCBLoopSource *src = calloc(1, sizeof(_XCBLoopSource));
+    struct epoll_event ev;
+    if(!src)
+    {   return NULL;
+    }
+    src->fd = fd;
+    src->timer = timer;
+    ev.events = events;
+    ev.data.ptr = src;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        free(src);
+        return NULL;
+    }
+    src->next = loop->sources;
+    loop->sources = src;
+    return src;
+}
+
+static int
+_xcb_loop_remove(XCBEventLoop *loop, int fd, u8 timer)
+{
+    _XCBLoopSource **link;
+    _XCBLoopSource *src;
+    for(link = &loop->sources; (src = *link); link = &src->next)
+    {
+        if(src->fd == fd && src->timer == timer && !src->dead)
+        {
+            epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+            if(timer)
+            {   close(fd);
+            }
+            /* a wakeup for it may still be in the ready list being walked */
+            if(loop->dispatching)
+            {   src->dead = 1;
+            }
+            else
+            {
+                *link = src->next;
+                free(src);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int
+XCBEventLoopAddFd(
+        XCBEventLoop *loop,
+        int fd,
+        uint32_t events,
+        XCBEventLoopFdCallback callback,
+        void *data
+        )
+{
+    _XCBLoopSource *src = _xcb_loop_add(loop, fd, events, 0);
+    if(!src)
+    {   return 0;
+    }
+    src->on_fd = callback;
+    src->data = data;
+    return 1;
+}
+
+int
+XCBEventLoopRemoveFd(
+        XCBEventLoop *loop,
+        int fd
+        )
+{   return _xcb_loop_remove(loop, fd, 0);
+}
+
+int
+XCBEventLoopAddTimer(
+        XCBEventLoop *loop,
+        uint32_t timeout_ms,
+        uint32_t interval_ms,
+        XCBEventLoopTimerCallback callback,
+        void *data
+        )
+{
+    struct itimerspec spec;
+    _XCBLoopSource *src;
+    const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if(fd < 0)
+    {   return -1;
+    }
+    /* a zero it_value disarms the timer */
+    timeout_ms += !timeout_ms;
+    spec.it_value.tv_sec = timeout_ms / 1000;
+    spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    if(timerfd_settime(fd, 0, &spec, NULL) < 0 || !(src = _xcb_loop_add(loop, fd, EPOLLIN, 1)))
+    {
+        close(fd);
+        return -1;
+    }
+    src->on_timer = callback;
+    src->data = data;
+    return fd;
+}
+
+int
+XCBEventLoopRemoveTimer(
+        XCBEventLoop *loop,
+        int timer
         )
-{   
-    return NULL;
+{   return _xcb_loop_remove(loop, timer, 1);
 }
 
-char *
-XCBErrorDisplayText(
-        uint8_t display_error
+/* Points the loop at where events come from now, the eventfd of the reader thread (XCBStartEventThread()) or the connection.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+static int
+_xcb_loop_watch(XCBEventLoop *loop, _XCBDisplayData *dd)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    const u32 source = dd && dd->reader ? dd->readers : 0;
+    int fd;
+    if(source == loop->source)
+    {   return 1;
+    }
+    /* a reader's eventfd left the set when it was closed, its number may be someone else's by now */
+    if(!loop->source)
+    {   epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->fd, NULL);
+    }
+    fd = source ? dd->reader->ready : xcb_get_file_descriptor(loop->display);
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {   return 0;
+    }
+    loop->fd = fd;
+    loop->source = source;
+    return 1;
+}
+
+/* Hands everything libxcb has to the callback, reading the connection only if fresh is set. */
+static int
+_xcb_loop_drain(XCBEventLoop *loop, _XCBDisplayData *dd, int fresh)
+{
+    XCBGenericEvent *ev;
+    int count = 0;
+    while((ev = _xcb_poll_next(loop->display, dd, fresh && !count)))
+    {
+        loop->callback(loop, ev, loop->data);
+        free(ev);
+        ++count;
+    }
+    return count;
+}
+
+int
+XCBEventLoopDispatch(
+        XCBEventLoop *loop,
+        int timeout_ms
         )
 {
-    char *errs[7] = 
+    _XCBDisplayData *dd = _xcb_dpy(loop->display);
+    struct epoll_event ready[32];
+    _XCBLoopSource **link;
+    _XCBLoopSource *src;
+    uint64_t expirations;
+    u64 now;
+    u64 due;
+    int count;
+    int wait;
+    int n;
+    int i;
+
+    /* libxcb may already hold events (or replies) read while waiting on something else, epoll wont see those */
+    count = _xcb_loop_drain(loop, dd, dd && dd->replies.len);
+    XCBFlush(loop->display);
+    if(_xcb_io_check(loop->display, dd))
+    {   return -1;
+    }
+    /* after the drain, it may have handed out the last of a stopped reader and freed it */
+    if(!_xcb_loop_watch(loop, dd))
+    {   return -1;
+    }
+    wait = count ? 0 : timeout_ms;
+    if(wait && dd && dd->mirror.interval)
     {
-        [0] = NULL,
-        [XCB_CONN_ERROR] = "DisplayError",
-        [XCB_CONN_CLOSED_EXT_NOTSUPPORTED] = "ExtensionNotSupported",
-        [XCB_CONN_CLOSED_MEM_INSUFFICIENT] = "OutOfMemory",
-        [XCB_CONN_CLOSED_REQ_LEN_EXCEED] = "TooManyRequests",
-        [XCB_CONN_CLOSED_PARSE_ERR] = "InvalidDisplay",
-        [XCB_CONN_CLOSED_INVALID_SCREEN] = "InvalidScreen"
-    };
-    /* bounds check */              /* & over && for better inlining */
-    display_error *= (display_error > 0) & (display_error < 7);
-    return errs[display_error];
+        now = _xcb_time_ms();
+        due = dd->mirror.checked + dd->mirror.interval;
+        due = due > now ? due - now : 0;
+        if(due < (wait < 0 ? (u64)INT32_MAX : (u64)wait))
+        {   wait = due;
+        }
+    }
+    n = epoll_wait(loop->epfd, ready, sizeof(ready) / sizeof(ready[0]), wait);
+    if(n < 0)
+    {   return errno == EINTR ? count : -1;
+    }
+    ++loop->dispatching;
+    for(i = 0; i < n; ++i)
+    {
+        src = ready[i].data.ptr;
+        if(!src)
+        {   
+            if(dd && dd->reader)
+            {   _xcb_eventfd_clear(dd->reader->ready);
+            }
+            count += _xcb_loop_drain(loop, dd, 1);
+        }
+        else if(src->dead)
+        {   continue;
+        }
+        else if(src->timer)
+        {
+            if(read(src->fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            {
+                src->on_timer(loop, src->fd, expirations, src->data);
+                ++count;
+            }
+        }
+        else
+        {
+            src->on_fd(loop, src->fd, ready[i].events, src->data);
+            ++count;
+        }
+    }
+    if(!--loop->dispatching)
+    {
+        link = &loop->sources;
+        while((src = *link))
+        {
+            if(src->dead)
+            {
+                *link = src->next;
+                free(src);
+            }
+            else
+            {   link = &src->next;
+            }
+        }
+    }
+    /* the self check costs round trips, so it only ever runs from here, see XCBSetMirrorSelfCheck() */
+    if(dd && dd->mirror.interval && (now = _xcb_time_ms()) - dd->mirror.checked >= dd->mirror.interval)
+    {
+        dd->mirror.checked = now;
+        _xcb_mirror_verify(loop->display, dd, 1);
+    }
+    if(_xcb_io_check(loop->display, dd))
+    {   return -1;
+    }
+    return count;
 }
 
+int
+XCBEventLoopRun(
+        XCBEventLoop *loop
+        )
+{
+    loop->stop = 0;
+    while(!loop->stop)
+    {
+        if(XCBEventLoopDispatch(loop, -1) < 0)
+        {   return -1;
+        }
+    }
+    loop->stop = 0;
+    return 0;
+}
 
+void
+XCBEventLoopStop(
+        XCBEventLoop *loop
+        )
+{   loop->stop = 1;
+}
 
-/* events */
+typedef struct _XCBHandler _XCBHandler;
 
+struct _XCBHandler
+{
+    XCBEventHandler fn;
+    void *data;
+    u32 mark;           /* batch in which rank was given out, see XCBDispatchEvents() */
+    u32 rank;
+};
 
+struct XCBDispatcher
+{
+    XCBDisplay *display;
+    _XCBHandler core[128];
+    _XCBMap generic;    /* ((extension << 16) | event_type) + 1 -> _XCBHandler * */
+    _XCBHandler fallback;
+    XCBDispatchTimingHook hook;
+    void *hook_data;
+    u32 mark;
+    u32 *scratch;
+    u32 scratch_cap;
+};
 
-XCBCookie
-XCBAllowEvents(XCBDisplay *display, u8 mode, XCBTimestamp tim)
+XCBDispatcher *
+XCBCreateDispatcher(
+        XCBDisplay *display
+        )
 {
-#if DBG
-    XCBCookie cookie = xcb_allow_events_checked(display, mode, tim);
-    ck(display, cookie, _fn);
-    return cookie;
-#endif
+    XCBDispatcher *dispatcher = calloc(1, sizeof(XCBDispatcher));
+    if(dispatcher)
+    {   dispatcher->display = display;
+    }
+    return dispatcher;
+}
 
-    return xcb_allow_events(display, mode, tim);
+void
+XCBFreeDispatcher(
+        XCBDispatcher *dispatcher
+        )
+{
+    u32 i;
+    if(!dispatcher)
+    {   return;
+    }
+    for(i = 0; i < dispatcher->generic.cap; ++i)
+    {
+        if(dispatcher->generic.keys[i] && dispatcher->generic.keys[i] != _XCB_MAP_TOMB)
+        {   free(dispatcher->generic.vals[i]);
+        }
+    }
+    _xcb_map_wipe(&dispatcher->generic);
+    free(dispatcher->scratch);
+    free(dispatcher);
 }
 
-XCBCookie
-XCBSendEvent(
-        XCBDisplay *display,
-        XCBWindow window,
-        uint8_t propagate,
-        uint32_t event_mask,
-        const char *event
+int
+XCBSetEventHandler(
+        XCBDispatcher *dispatcher,
+        uint8_t response_type,
+        XCBEventHandler handler,
+        void *data
         )
 {
-    return xcb_send_event(display, propagate, window, event_mask, event);
+    if(response_type > 127)
+    {   return 0;
+    }
+    dispatcher->core[response_type].fn = handler;
+    dispatcher->core[response_type].data = data;
+    return 1;
 }
 
-int 
-XCBNextEvent(XCBDisplay *display, XCBGenericEvent **event_return) 
+int
+XCBSetGenericEventHandler(
+        XCBDispatcher *dispatcher,
+        uint8_t extension,
+        uint16_t event_type,
+        XCBEventHandler handler,
+        void *data
+        )
 {
-    /* waits till next event happens before returning */
-    return !!(*event_return = xcb_wait_for_event(display));
+    const u32 key = (((u32)extension << 16) | event_type) + 1;
+    void **slot = _xcb_map_get(&dispatcher->generic, key);
+    _XCBHandler *h;
+    if(!handler)
+    {
+        if(slot)
+        {   
+            free(*slot);
+            _xcb_map_del(&dispatcher->generic, key);
+        }
+        return 1;
+    }
+    if(!slot)
+    {
+        h = calloc(1, sizeof(_XCBHandler));
+        if(!h)
+        {   return 0;
+        }
+        slot = _xcb_map_set(&dispatcher->generic, key);
+        if(!slot)
+        {
+            free(h);
+            return 0;
+        }
+        *slot = h;
+    }
+    h = *slot;
+    h->fn = handler;
+    h->data = data;
+    return 1;
 }
 
-XCBGenericEvent *
-XCBWaitForEvent(XCBDisplay *display)
+void
+XCBSetDefaultEventHandler(
+        XCBDispatcher *dispatcher,
+        XCBEventHandler handler,
+        void *data
+        )
 {
-    /* waits till next event happens before returning */
-    return xcb_wait_for_event(display);
+    dispatcher->fallback.fn = handler;
+    dispatcher->fallback.data = data;
 }
 
-XCBGenericEvent *
-XCBPollForEvent(XCBDisplay *display)
+void
+XCBSetDispatchTimingHook(
+        XCBDispatcher *dispatcher,
+        XCBDispatchTimingHook hook,
+        void *data
+        )
 {
-    /* TODO */
-    /* If I/O error do something */
-   return  xcb_poll_for_event(display);
+    dispatcher->hook = hook;
+    dispatcher->hook_data = data;
 }
 
-XCBGenericEvent *
-XCBPollForQueuedEvent(XCBDisplay *display)
+static _XCBHandler *
+_xcb_dispatch_find(XCBDispatcher *dispatcher, const XCBGenericEvent *event)
 {
-    return xcb_poll_for_queued_event(display);
+    const u8 type = event->response_type & 0x7f;
+    const xcb_ge_generic_event_t *ge;
+    void **slot;
+    if(type == XCB_GE_GENERIC)
+    {
+        ge = (const xcb_ge_generic_event_t *)event;
+        slot = _xcb_map_get(&dispatcher->generic, (((u32)ge->extension << 16) | ge->event_type) + 1);
+        if(slot)
+        {   return *slot;
+        }
+    }
+    if(dispatcher->core[type].fn)
+    {   return &dispatcher->core[type];
+    }
+    return dispatcher->fallback.fn ? &dispatcher->fallback : NULL;
 }
 
-void *
-XCBCheckReply(
-        XCBDisplay *display, 
-        XCBCookie request)
+static void
+_xcb_dispatch_run(XCBDispatcher *dispatcher, _XCBHandler *h, XCBGenericEvent *event)
 {
-    XCBGenericError *err = NULL;
-    void *reply = NULL;
-    xcb_poll_for_reply(display, request.sequence, &reply, &err);
+    struct timespec start;
+    struct timespec end;
+    if(!dispatcher->hook)
+    {   
+        h->fn(dispatcher->display, event, h->data);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    h->fn(dispatcher->display, event, h->data);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    dispatcher->hook(dispatcher, event, (u64)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec, dispatcher->hook_data);
+}
 
-    if(err)
-    {    
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
-        }
-        return NULL;
+int
+XCBDispatchEvent(
+        XCBDispatcher *dispatcher,
+        XCBGenericEvent *event
+        )
+{
+    _XCBHandler *h = _xcb_dispatch_find(dispatcher, event);
+    if(!h)
+    {   return 0;
     }
-    return reply;
+    _xcb_dispatch_run(dispatcher, h, event);
+    return 1;
 }
 
-void *
-XCBCheckReply64(
-        XCBDisplay *display, 
-        XCBCookie64 request)
-{   
-    XCBGenericError *err = NULL;
-    void *reply = NULL;
-    xcb_poll_for_reply64(display, request.sequence, &reply, &err);
+uint32_t
+XCBDispatchEvents(
+        XCBDispatcher *dispatcher,
+        XCBGenericEvent *events,
+        uint32_t count
+        )
+{
+    _XCBHandler *h;
+    u32 *rank;
+    u32 *start;
+    u32 *order;
+    u32 groups;
+    u32 ran;
+    u32 i;
+    void *p;
+
+    if(count > (UINT32_MAX - 1) / 3)
+    {   return 0;
+    }
+    if(dispatcher->scratch_cap < count * 3 + 1)
+    {
+        p = realloc(dispatcher->scratch, (count * 3 + 1) * sizeof(u32));
+        if(!p)
+        {   
+            /* out of memory, ungrouped still works */
+            for(i = ran = 0; i < count; ++i)
+            {   ran += XCBDispatchEvent(dispatcher, events + i);
+            }
+            return ran;
+        }
+        dispatcher->scratch = p;
+        dispatcher->scratch_cap = count * 3 + 1;
+    }
+    rank = dispatcher->scratch;
+    start = rank + count;
+    order = start + count + 1;
 
-    if(err)
-    {    
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
+    if(!++dispatcher->mark)
+    {
+        /* wrapped, stale marks could match again */
+        for(i = 0; i < 128; ++i)
+        {   dispatcher->core[i].mark = 0;
         }
-        return NULL;
+        for(i = 0; i < dispatcher->generic.cap; ++i)
+        {
+            if(dispatcher->generic.keys[i] && dispatcher->generic.keys[i] != _XCB_MAP_TOMB)
+            {   ((_XCBHandler *)dispatcher->generic.vals[i])->mark = 0;
+            }
+        }
+        dispatcher->fallback.mark = 0;
+        dispatcher->mark = 1;
     }
-    return reply;
+    /* counting sort on the rank of each handler, ranks given out by first appearance */
+    groups = 0;
+    memset(start, 0, (count + 1) * sizeof(u32));
+    for(i = 0; i < count; ++i)
+    {
+        h = _xcb_dispatch_find(dispatcher, events + i);
+        if(!h)
+        {   
+            rank[i] = UINT32_MAX;
+            continue;
+        }
+        if(h->mark != dispatcher->mark)
+        {
+            h->mark = dispatcher->mark;
+            h->rank = groups++;
+        }
+        rank[i] = h->rank;
+        ++start[h->rank + 1];
+    }
+    for(i = 1; i <= groups; ++i)
+    {   start[i] += start[i - 1];
+    }
+    ran = start[groups];
+    for(i = 0; i < count; ++i)
+    {
+        if(rank[i] != UINT32_MAX)
+        {   order[start[rank[i]]++] = i;
+        }
+    }
+    for(i = 0; i < ran; ++i)
+    {
+        /* looked up again, a handler may have changed the table */
+        h = _xcb_dispatch_find(dispatcher, events + order[i]);
+        if(h)
+        {   _xcb_dispatch_run(dispatcher, h, events + order[i]);
+        }
+    }
+    return ran;
 }
 
+struct XCBBatch
+{
+    XCBDisplay *display;
+    _XCBBatchSlot *slots;
+    u32 len;
+    u32 cap;
+    u8 sorted;          /* added in sequence order, the common case */
+};
 
-void *
-XCBWaitForReply(
+static int
+_xcb_batch_cmp(const void *a, const void *b)
+{
+    /* sequences wrap, compare by distance */
+    const i32 diff = (i32)(((const _XCBBatchSlot *)a)->sequence - ((const _XCBBatchSlot *)b)->sequence);
+    return (diff > 0) - (diff < 0);
+}
+
+XCBBatch *
+XCBCreateBatch(
         XCBDisplay *display,
-        XCBCookie cookie
+        u32 size_hint
         )
 {
-    XCBGenericError *err = NULL;
-    void *reply = xcb_wait_for_reply(display, cookie.sequence, &err);
-    if(err)
+    XCBBatch *batch = calloc(1, sizeof(XCBBatch));
+    if(!batch)
+    {   return NULL;
+    }
+    batch->display = display;
+    batch->cap = size_hint ? size_hint : 64;
+    batch->slots = malloc(batch->cap * sizeof(_XCBBatchSlot));
+    batch->sorted = 1;
+    if(!batch->slots)
     {   
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
-        }
+        free(batch);
         return NULL;
     }
-    return reply;
+    return batch;
+}
+
+void
+XCBFreeBatch(
+        XCBBatch *batch
+        )
+{
+    u32 i;
+    if(!batch)
+    {   return;
+    }
+    for(i = 0; i < batch->len; ++i)
+    {   xcb_discard_reply(batch->display, batch->slots[i].sequence);
+    }
+    free(batch->slots);
+    free(batch);
+}
+
+int
+XCBBatchAdd(
+        XCBBatch *batch,
+        XCBCookie cookie,
+        void **reply_return,
+        XCBGenericError *error_return
+        )
+{
+    _XCBBatchSlot *slot;
+    if(reply_return)
+    {   *reply_return = NULL;
+    }
+    if(error_return)
+    {   memset(error_return, 0, sizeof(XCBGenericError));
+    }
+    if(batch->len == batch->cap)
+    {
+        const u32 cap = batch->cap << 1;
+        _XCBBatchSlot *slots = realloc(batch->slots, cap * sizeof(_XCBBatchSlot));
+        if(!slots)
+        {   
+            xcb_discard_reply(batch->display, cookie.sequence);
+            return 0;
+        }
+        batch->slots = slots;
+        batch->cap = cap;
+    }
+    if(batch->len && (i32)(cookie.sequence - batch->slots[batch->len - 1].sequence) < 0)
+    {   batch->sorted = 0;
+    }
+    slot = &batch->slots[batch->len++];
+    slot->sequence = cookie.sequence;
+    slot->reply = reply_return;
+    slot->error = error_return;
+    return 1;
+}
+
+int
+XCBBatchGetWindowAttributes(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBGetWindowAttributes **reply_return,
+        XCBGenericError *error_return
+        )
+{
+    const XCBCookie cookie = XCBGetWindowAttributesCookie(batch->display, window);
+    return XCBBatchAdd(batch, cookie, (void **)reply_return, error_return);
+}
+
+int
+XCBBatchGetWindowGeometry(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBGeometry **reply_return,
+        XCBGenericError *error_return
+        )
+{
+    const XCBCookie cookie = XCBGetWindowGeometryCookie(batch->display, window);
+    return XCBBatchAdd(batch, cookie, (void **)reply_return, error_return);
+}
+
+int
+XCBBatchGetWindowProperty(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBAtom property,
+        u32 long_offset,
+        u32 long_length,
+        u8 _delete,
+        XCBAtom req_type,
+        XCBWindowProperty **reply_return,
+        XCBGenericError *error_return
+        )
+{
+    const XCBCookie cookie = XCBGetWindowPropertyCookie(batch->display, window, property, long_offset, long_length, _delete, req_type);
+    return XCBBatchAdd(batch, cookie, (void **)reply_return, error_return);
+}
+
+int
+XCBBatchQueryTree(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBQueryTree **reply_return,
+        XCBGenericError *error_return
+        )
+{
+    const XCBCookie cookie = XCBQueryTreeCookie(batch->display, window);
+    return XCBBatchAdd(batch, cookie, (void **)reply_return, error_return);
 }
 
-void *
-XCBWaitForReply64(
-        XCBDisplay *display,
-        XCBCookie64 cookie
+u32
+XCBBatchDrain(
+        XCBBatch *batch
         )
 {
-    XCBGenericError *err = NULL;
-    void *reply = xcb_wait_for_reply64(display, cookie.sequence, &err);
-    if(err)
-    {   
-        _xcb_err_handler(display, err);
-        if(reply)
+    _XCBBatchSlot *slot;
+    XCBGenericError *err;
+    void *reply;
+    u32 failed = 0;
+    u32 i;
+
+    if(!batch->len)
+    {   return 0;
+    }
+    if(!batch->sorted)
+    {   qsort(batch->slots, batch->len, sizeof(_XCBBatchSlot), _xcb_batch_cmp);
+    }
+    xcb_flush(batch->display);
+    for(i = 0; i < batch->len; ++i)
+    {
+        slot = &batch->slots[i];
+        if(!slot->reply && !slot->error)
+        {   
+            xcb_discard_reply(batch->display, slot->sequence);
+            continue;
+        }
+        err = NULL;
+        reply = xcb_wait_for_reply(batch->display, slot->sequence, &err);
+        if(err)
+        {
+            if(slot->error)
+            {   
+                *slot->error = *err;
+                free(err);
+            }
+            else
+            {   _xcb_err_handler(batch->display, err);
+            }
+            free(reply);
+            reply = NULL;
+        }
+        /* no reply and no error is a IOError */
+        failed += !reply;
+        if(slot->reply)
+        {   *slot->reply = reply;
+        }
+        else
         {   free(reply);
         }
-        return NULL;
     }
-    return reply;
+    batch->len = 0;
+    batch->sorted = 1;
+    return failed;
 }
 
 XCBCookie
@@ -1385,80 +7025,806 @@ XCBGrabButton(
     return xcb_grab_button(display, owner_events, grab_window, event_mask, pointer_mode, keyboard_mode, confine_to, cursor, button, modifiers);
 }
 
-XCBCookie
-XCBGrabPointerCookie(
+typedef struct _XCBGrabBinding _XCBGrabBinding;
+typedef struct _XCBGrab _XCBGrab;
+
+struct _XCBGrabBinding
+{
+    XCBKeysym keysym;
+    u16 modifiers;
+    u16 event_mask;
+    u8 button;
+    u8 pointer_mode;
+    u8 is_button;
+};
+
+/* one request worth of grab, kept sorted by id */
+struct _XCBGrab
+{
+    u32 id;
+    u32 order;                  /* binding index, the later binding wins a shared id */
+    u16 event_mask;
+    u8 pointer_mode;
+};
+
+struct XCBGrabSet
+{
+    XCBDisplay *display;
+    XCBWindow window;
+    _XCBGrabBinding *bindings;
+    u32 len;
+    u32 cap;
+    _XCBGrab *applied;          /* what the server has, as of the last apply */
+    u32 applied_len;
+};
+
+#define _XCB_GRAB_BUTTON            (1u << 24)
+#define _XCB_GRAB_ID(is_button, detail, modifiers)  (((is_button) ? _XCB_GRAB_BUTTON : 0) | (u32)(detail) << 16 | (u16)(modifiers))
+#define _XCB_GRAB_DETAIL(id)        ((u8)((id) >> 16))
+#define _XCB_GRAB_MODIFIERS(id)     ((u16)(id))
+
+static int
+_xcb_grab_cmp(const void *a, const void *b)
+{
+    const _XCBGrab *x = a;
+    const _XCBGrab *y = b;
+    if(x->id != y->id)
+    {   return x->id < y->id ? -1 : 1;
+    }
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static const _XCBGrab *
+_xcb_grab_find(const _XCBGrab *grabs, u32 len, u32 id)
+{
+    u32 lo = 0;
+    u32 hi = len;
+    u32 mid;
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(grabs[mid].id < id)
+        {   lo = mid + 1;
+        }
+        else
+        {   hi = mid;
+        }
+    }
+    return lo < len && grabs[lo].id == id ? grabs + lo : NULL;
+}
+
+/* Checks if two grabs match some of the same key (or button) and modifiers, 0 (AnyKey, AnyButton) and
+ * XCB_MOD_MASK_ANY matching all; the server releases (or splits) every grab an ungrab overlaps.
+ */
+static int
+_xcb_grab_overlaps(u32 a, u32 b)
+{
+    const u16 am = _XCB_GRAB_MODIFIERS(a);
+    const u16 bm = _XCB_GRAB_MODIFIERS(b);
+    const u8 ad = _XCB_GRAB_DETAIL(a);
+    const u8 bd = _XCB_GRAB_DETAIL(b);
+    return (a & _XCB_GRAB_BUTTON) == (b & _XCB_GRAB_BUTTON)
+        && (ad == bd || !ad || !bd)
+        && (am == bm || am == XCB_MOD_MASK_ANY || bm == XCB_MOD_MASK_ANY);
+}
+
+/* RETURN: Number of wildcards in id, 0 (AnyKey, AnyButton) and XCB_MOD_MASK_ANY. */
+static u32
+_xcb_grab_level(u32 id)
+{
+    return !_XCB_GRAB_DETAIL(id) + (_XCB_GRAB_MODIFIERS(id) == XCB_MOD_MASK_ANY);
+}
+
+static void
+_xcb_grab_send(XCBDisplay *display, XCBWindow window, const _XCBGrab *grab, int ungrab)
+{
+    const u8 detail = _XCB_GRAB_DETAIL(grab->id);
+    const u16 modifiers = _XCB_GRAB_MODIFIERS(grab->id);
+    if(grab->id & _XCB_GRAB_BUTTON)
+    {
+        if(ungrab)
+        {   XCBUngrabButton(display, detail, modifiers, window);
+        }
+        else
+        {   XCBGrabButton(display, detail, modifiers, window, 1, grab->event_mask, grab->pointer_mode, XCB_GRAB_MODE_ASYNC, XCB_NONE, XCB_NONE);
+        }
+    }
+    else
+    {
+        if(ungrab)
+        {   XCBUngrabKey(display, detail, modifiers, window);
+        }
+        else
+        {   XCBGrabKey(display, detail, modifiers, window, 1, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+        }
+    }
+}
+
+/* Defined with the rest of the keymap, key bindings need it loaded before their keycodes can be trusted. */
+static int _xcb_keymap_load(XCBDisplay *display, _XCBKeymap *km);
+
+/* Gets the distinct masks of the lock modifiers, CapsLock (always XCB_MOD_MASK_LOCK), then NumLock and ScrollLock when mapped.
+ *
+ * RETURN: Number of masks filled on Success.
+ * RETURN: 0 on Failure.
+ */
+static u32
+_xcb_grab_locks(XCBDisplay *display, u16 masks_return[3])
+{
+    XCBModifierMasks masks;
+    u16 seen = XCB_MOD_MASK_LOCK;
+    u32 count = 0;
+    if(!XCBKeymapGetModifierMasks(display, &masks))
+    {   return 0;
+    }
+    masks_return[count++] = XCB_MOD_MASK_LOCK;
+    if(masks.num_lock & ~seen)
+    {   
+        masks_return[count++] = masks.num_lock & ~seen;
+        seen |= masks.num_lock;
+    }
+    if(masks.scroll_lock & ~seen)
+    {   masks_return[count++] = masks.scroll_lock & ~seen;
+    }
+    return count;
+}
+
+XCBGrabSet *
+XCBCreateGrabSet(
+        XCBDisplay *display,
+        XCBWindow grab_window
+        )
+{
+    XCBGrabSet *set = calloc(1, sizeof(XCBGrabSet));
+    if(set)
+    {
+        set->display = display;
+        set->window = grab_window;
+    }
+    return set;
+}
+
+void
+XCBFreeGrabSet(
+        XCBGrabSet *set
+        )
+{
+    if(!set)
+    {   return;
+    }
+    free(set->bindings);
+    free(set->applied);
+    free(set);
+}
+
+static int
+_xcb_grab_add(XCBGrabSet *set, const _XCBGrabBinding *binding)
+{
+    _XCBGrabBinding *bindings;
+    u32 cap;
+    if(set->len == set->cap)
+    {
+        cap = set->cap ? set->cap * 2 : 16;
+        bindings = realloc(set->bindings, cap * sizeof(_XCBGrabBinding));
+        if(!bindings)
+        {   return 0;
+        }
+        set->bindings = bindings;
+        set->cap = cap;
+    }
+    set->bindings[set->len++] = *binding;
+    return 1;
+}
+
+int
+XCBGrabSetAddKey(
+        XCBGrabSet *set,
+        XCBKeysym keysym,
+        u16 modifiers
+        )
+{
+    const _XCBGrabBinding binding = { .keysym = keysym, .modifiers = modifiers };
+    if(keysym == XCB_NO_SYMBOL)
+    {   return 0;
+    }
+    return _xcb_grab_add(set, &binding);
+}
+
+int
+XCBGrabSetAddButton(
+        XCBGrabSet *set,
+        u8 button,
+        u16 modifiers,
+        u16 event_mask,
+        u8 pointer_mode
+        )
+{
+    const _XCBGrabBinding binding = 
+    {   .modifiers = modifiers, .event_mask = event_mask, .button = button, .pointer_mode = pointer_mode, .is_button = 1
+    };
+    u32 i;
+    for(i = 0; i < set->len; ++i)
+    {
+        if(set->bindings[i].is_button && set->bindings[i].button == button && set->bindings[i].modifiers == modifiers)
+        {
+            set->bindings[i] = binding;
+            return 1;
+        }
+    }
+    return _xcb_grab_add(set, &binding);
+}
+
+void
+XCBGrabSetClear(
+        XCBGrabSet *set
+        )
+{
+    set->len = 0;
+}
+
+int
+XCBGrabSetApply(
+        XCBGrabSet *set
+        )
+{
+    XCBDisplay *display = set->display;
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    const _XCBGrabBinding *binding;
+    const _XCBGrab *have;
+    _XCBGrab *want = NULL;
+    _XCBGrab *tmp;
+    XCBKeyCode keycodes[256];
+    u16 locks[3];
+    u16 extra;
+    u32 nlocks = 0;
+    u32 nkeys;
+    u32 combos;
+    u32 len = 0;
+    u32 cap = 0;
+    u32 *touched;
+    u32 ntouched = 0;
+    u32 before;
+    u32 level;
+    u32 b, k, c, i, j;
+    int regrab;
+    int sent = 0;
+
+    if(set->len)
+    {
+        nlocks = _xcb_grab_locks(display, locks);
+        if(!nlocks)
+        {   return -1;
+        }
+    }
+    for(b = 0; b < set->len; ++b)
+    {
+        if(!set->bindings[b].is_button)
+        {
+            /* a keymap that wont load gives every key no keycodes, which would ungrab them all */
+            if(!dd || !_xcb_keymap_load(display, &dd->keymap))
+            {   return -1;
+            }
+            break;
+        }
+    }
+    for(b = 0; b < set->len; ++b)
+    {
+        binding = set->bindings + b;
+        if(binding->is_button)
+        {
+            keycodes[0] = binding->button;
+            nkeys = 1;
+        }
+        else
+        {   nkeys = XCBKeymapGetKeycodes(display, binding->keysym, keycodes, 256);
+        }
+        combos = binding->modifiers == XCB_MOD_MASK_ANY ? 1 : 1u << nlocks;
+        if(len + nkeys * combos > cap)
+        {
+            cap = (len + nkeys * combos) * 2;
+            tmp = realloc(want, cap * sizeof(_XCBGrab));
+            if(!tmp)
+            {   goto FAILURE;
+            }
+            want = tmp;
+        }
+        for(k = 0; k < nkeys; ++k)
+        {
+            for(c = 0; c < combos; ++c)
+            {
+                extra = 0;
+                for(i = 0; i < nlocks; ++i)
+                {
+                    if(c & (1u << i))
+                    {   extra |= locks[i];
+                    }
+                }
+                want[len++] = (_XCBGrab)
+                {   .id = _XCB_GRAB_ID(binding->is_button, keycodes[k], binding->modifiers | extra),
+                    .order = b, .event_mask = binding->event_mask, .pointer_mode = binding->pointer_mode
+                };
+            }
+        }
+    }
+    if(len)
+    {
+        qsort(want, len, sizeof(_XCBGrab), _xcb_grab_cmp);
+        /* keep the last of each id */
+        for(i = 1, j = 0; i < len; ++i)
+        {
+            if(want[i].id != want[j].id)
+            {   ++j;
+            }
+            want[j] = want[i];
+        }
+        len = j + 1;
+    }
+
+    /* anything released or grabbed over (wildcards replace the grabs of theirs they match) */
+    touched = malloc((set->applied_len + len + 1) * sizeof(u32));
+    if(!touched)
+    {   goto FAILURE;
+    }
+    /* ungrabs first, then wildcard grabs most general first, anything they overlapped is grabbed again after */
+    for(i = 0; i < set->applied_len; ++i)
+    {
+        if(!_xcb_grab_find(want, len, set->applied[i].id))
+        {
+            _xcb_grab_send(display, set->window, set->applied + i, 1);
+            touched[ntouched++] = set->applied[i].id;
+        }
+    }
+    sent = ntouched;
+    for(level = 3; level-- > 0; )
+    {
+        before = ntouched;
+        for(j = 0; j < len; ++j)
+        {
+            if(_xcb_grab_level(want[j].id) != level)
+            {   continue;
+            }
+            have = _xcb_grab_find(set->applied, set->applied_len, want[j].id);
+            regrab = !have || have->event_mask != want[j].event_mask || have->pointer_mode != want[j].pointer_mode;
+            for(i = 0; i < before && !regrab; ++i)
+            {   regrab = _xcb_grab_overlaps(touched[i], want[j].id);
+            }
+            if(regrab)
+            {
+                _xcb_grab_send(display, set->window, want + j, 0);
+                touched[ntouched++] = want[j].id;
+                ++sent;
+            }
+        }
+    }
+    free(touched);
+    if(sent)
+    {   xcb_flush(display);
+    }
+    free(set->applied);
+    set->applied = want;
+    set->applied_len = len;
+    return sent;
+FAILURE:
+    free(want);
+    return -1;
+}
+
+XCBCookie
+XCBGrabPointerCookie(
+        XCBDisplay *display,
+        XCBWindow grab_window,
+        uint8_t owner_events,
+        uint16_t event_mask,
+        uint8_t pointer_mode,
+        uint8_t keyboard_mode,
+        XCBWindow confine_to,
+        XCBCursor cursor,
+        XCBTimestamp tim
+        )
+{
+    xcb_grab_pointer_cookie_t cookie = xcb_grab_pointer(
+            display, owner_events, grab_window, event_mask, pointer_mode, keyboard_mode, confine_to, cursor, tim
+            );
+
+    return (XCBCookie) { .sequence = cookie.sequence };
+
+}
+
+XCBGrabPointer *
+XCBGrabPointerReply(
+        XCBDisplay *display,
+        XCBCookie cookie
+        )
+{
+    const xcb_grab_pointer_cookie_t cookie1 = { .sequence = cookie.sequence };
+    XCBGenericError *err = NULL;
+    xcb_grab_pointer_reply_t *reply = xcb_grab_pointer_reply(display, cookie1, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+
+}
+
+
+int
+XCBDisplayKeyCodes(XCBDisplay *display, int *min_keycode_return, int *max_keycode_return)
+{
+    const XCBSetup *setup = xcb_get_setup(display);
+    *min_keycode_return = setup->min_keycode;
+    *max_keycode_return = setup->max_keycode;
+    return 1;
+}
+
+int 
+XCBDisplayKeycodes(XCBDisplay *display, int *min_keycode_return, int *max_keycode_return)
+{
+    const XCBSetup *setup = xcb_get_setup(display);
+    *min_keycode_return = setup->min_keycode;
+    *max_keycode_return = setup->max_keycode;
+    return 1;
+}
+
+/* Latin 1 only, which covers what keybindings use, keysyms of other scripts are left as they are. */
+static void
+_xcb_keysym_case(XCBKeysym sym, XCBKeysym *lower_return, XCBKeysym *upper_return)
+{
+    *lower_return = *upper_return = sym;
+    /* XK_a ... XK_z, XK_agrave ... XK_thorn less XK_division */
+    if((sym >= 0x61 && sym <= 0x7a) || (sym >= 0xe0 && sym <= 0xfe && sym != 0xf7))
+    {   *upper_return = sym - 0x20;
+    }
+    /* XK_A ... XK_Z, XK_Agrave ... XK_THORN less XK_multiply */
+    else if((sym >= 0x41 && sym <= 0x5a) || (sym >= 0xc0 && sym <= 0xde && sym != 0xd7))
+    {   *lower_return = sym + 0x20;
+    }
+}
+
+/* Fills a row of width from the per keysyms the server gave, same rules as xcb_key_symbols_get_keysym(). */
+static void
+_xcb_keymap_row(const XCBKeysym *raw, u8 per, u8 width, XCBKeysym *row)
+{
+    XCBKeysym lower;
+    XCBKeysym upper;
+    u8 used = per;
+    u8 col;
+    u8 c;
+    u8 n;
+    while(used > 2 && raw[used - 1] == XCB_NO_SYMBOL)
+    {   --used;
+    }
+    for(col = 0; col < width; ++col)
+    {
+        if(col >= 4)
+        {   
+            row[col] = col < per ? raw[col] : XCB_NO_SYMBOL;
+            continue;
+        }
+        /* group 2 counts without trailing NoSymbol, a single group is used for both */
+        n = col > 1 ? used : per;
+        c = col > 1 && used < 3 ? col - 2 : col;
+        if(n <= (c | 1) || raw[c | 1] == XCB_NO_SYMBOL)
+        {
+            _xcb_keysym_case(raw[c & ~1], &lower, &upper);
+            row[col] = !(c & 1) ? lower : upper == lower ? XCB_NO_SYMBOL : upper;
+        }
+        else
+        {   row[col] = raw[c];
+        }
+    }
+}
+
+/* XCBKeySymbolsGetKeyCode() order of a position, column then keycode */
+#define _XCB_KEYMAP_ORDER(km, pos)  ((pos) % (km)->width << 8 | (pos) / (km)->width)
+
+/* Links (or unlinks) positions of keycodes first ... last into the keysym index, a lookup walks them in order.
+ * Linked last to first so loading the whole keymap only ever links at the front.
+ */
+static void
+_xcb_keymap_link(_XCBKeymap *km, u8 first, u8 last, int link)
+{
+    void **slot;
+    XCBKeysym sym;
+    u32 pos;
+    u32 at;
+    u32 prev;
+    int col;
+    int key;
+    for(col = km->per - 1; col >= 0; --col)
+    {
+        for(key = last; key >= first; --key)
+        {
+            pos = (key - km->min) * km->width + col;
+            sym = km->syms[pos];
+            if(sym == XCB_NO_SYMBOL)
+            {   continue;
+            }
+            if(link)
+            {
+                slot = _xcb_map_set(&km->index, sym);
+                /* out of memory, the keysym just isnt found */
+                if(!slot)
+                {   continue;
+                }
+                /* kept in order, which is always the front when loading everything */
+                prev = 0;
+                for(at = (uintptr_t)*slot; at && _XCB_KEYMAP_ORDER(km, at - 1) < _XCB_KEYMAP_ORDER(km, pos); at = km->next[at - 1])
+                {   prev = at;
+                }
+                km->next[pos] = at;
+                if(prev)
+                {   km->next[prev - 1] = pos + 1;
+                }
+                else
+                {   *slot = (void *)(uintptr_t)(pos + 1);
+                }
+                continue;
+            }
+            slot = _xcb_map_get(&km->index, sym);
+            if(!slot)
+            {   continue;
+            }
+            prev = 0;
+            for(at = (uintptr_t)*slot; at && at != pos + 1; at = km->next[at - 1])
+            {   prev = at;
+            }
+            if(!at)
+            {   continue;
+            }
+            if(prev)
+            {   km->next[prev - 1] = km->next[pos];
+            }
+            else if(km->next[pos])
+            {   *slot = (void *)(uintptr_t)km->next[pos];
+            }
+            else
+            {   _xcb_map_del(&km->index, sym);
+            }
+            km->next[pos] = 0;
+        }
+    }
+}
+
+/* Loads the keymap, or only the keycodes MappingNotify changed since.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+static int
+_xcb_keymap_load(XCBDisplay *display, _XCBKeymap *km)
+{
+    const XCBSetup *setup = xcb_get_setup(display);
+    xcb_get_keyboard_mapping_reply_t *reply;
+    XCBGenericError *err = NULL;
+    const XCBKeysym *raw;
+    int full = !km->loaded;
+    u32 rows;
+    u8 first;
+    u8 last;
+    u8 key;
+
+    if(km->loaded && !km->dirty)
+    {   return 1;
+    }
+RETRY:
+    first = full || km->first < km->min ? setup->min_keycode : km->first;
+    last = full || km->last > km->max ? setup->max_keycode : km->last;
+    reply = xcb_get_keyboard_mapping_reply(display, xcb_get_keyboard_mapping(display, first, last - first + 1), &err);
+    if(err)
+    {
+        _xcb_err_handler(display, err);
+        free(reply);
+        return 0;
+    }
+    if(!reply || !reply->keysyms_per_keycode)
+    {   
+        free(reply);
+        return 0;
+    }
+    /* the table has to be laid out again */
+    if(!full && reply->keysyms_per_keycode != km->per)
+    {
+        free(reply);
+        _xcb_keymap_wipe(km);
+        full = 1;
+        goto RETRY;
+    }
+    if(full)
+    {
+        _xcb_keymap_wipe(km);
+        km->min = setup->min_keycode;
+        km->max = setup->max_keycode;
+        km->per = reply->keysyms_per_keycode;
+        km->width = km->per < 4 ? 4 : km->per;
+        rows = km->max - km->min + 1;
+        km->syms = calloc(rows * km->width, sizeof(XCBKeysym));
+        km->next = calloc(rows * km->width, sizeof(u16));
+        if(!km->syms || !km->next)
+        {
+            free(reply);
+            _xcb_keymap_wipe(km);
+            return 0;
+        }
+    }
+    else
+    {   _xcb_keymap_link(km, first, last, 0);
+    }
+    raw = xcb_get_keyboard_mapping_keysyms(reply);
+    for(key = first; key >= first && key <= last; ++key)
+    {   _xcb_keymap_row(raw + (key - first) * km->per, km->per, km->width, km->syms + (key - km->min) * km->width);
+    }
+    _xcb_keymap_link(km, first, last, 1);
+    free(reply);
+    km->loaded = 1;
+    km->dirty = 0;
+    return 1;
+}
+
+u32
+XCBKeymapGetKeycodes(
         XCBDisplay *display,
-        XCBWindow grab_window,
-        uint8_t owner_events,
-        uint16_t event_mask,
-        uint8_t pointer_mode,
-        uint8_t keyboard_mode,
-        XCBWindow confine_to,
-        XCBCursor cursor,
-        XCBTimestamp tim
+        XCBKeysym keysym,
+        XCBKeyCode *keycodes_return,
+        u32 max
         )
 {
-    xcb_grab_pointer_cookie_t cookie = xcb_grab_pointer(
-            display, owner_events, grab_window, event_mask, pointer_mode, keyboard_mode, confine_to, cursor, tim
-            );
-
-    return (XCBCookie) { .sequence = cookie.sequence };
-
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBKeymap *km;
+    void **slot;
+    u8 seen[256 / 8] = { 0 };
+    XCBKeyCode key;
+    u32 count = 0;
+    u32 at;
+    if(!dd || !_xcb_keymap_load(display, &dd->keymap))
+    {   return 0;
+    }
+    km = &dd->keymap;
+    slot = _xcb_map_get(&km->index, keysym);
+    for(at = slot ? (uintptr_t)*slot : 0; at && count < max; at = km->next[at - 1])
+    {
+        key = (at - 1) / km->width + km->min;
+        if(!(seen[key / 8] & (1 << key % 8)))
+        {
+            seen[key / 8] |= 1 << key % 8;
+            keycodes_return[count++] = key;
+        }
+    }
+    return count;
 }
 
-XCBGrabPointer *
-XCBGrabPointerReply(
+XCBKeysym
+XCBKeymapGetKeysym(
         XCBDisplay *display,
-        XCBCookie cookie
+        XCBKeyCode keycode,
+        u8 column
         )
 {
-    const xcb_grab_pointer_cookie_t cookie1 = { .sequence = cookie.sequence };
-    XCBGenericError *err = NULL;
-    xcb_grab_pointer_reply_t *reply = xcb_grab_pointer_reply(display, cookie1, &err);
-    if(err)
-    {   
-        _xcb_err_handler(display, err);
-        if(reply)
-        {   free(reply);
-        }
-        return NULL;
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBKeymap *km;
+    if(!dd || !_xcb_keymap_load(display, &dd->keymap))
+    {   return XCB_NO_SYMBOL;
     }
-    return reply;
+    km = &dd->keymap;
+    if(keycode < km->min || keycode > km->max || column >= km->width)
+    {   return XCB_NO_SYMBOL;
+    }
+    return km->syms[(keycode - km->min) * km->width + column];
+}
 
+/* RETURN: Mask of the modifiers any keycode of keysym is on. */
+static u16
+_xcb_modmap_mask(XCBDisplay *display, const _XCBModmap *mm, XCBKeysym keysym)
+{
+    XCBKeyCode keycodes[256];
+    const u32 count = XCBKeymapGetKeycodes(display, keysym, keycodes, 256);
+    u16 mask = 0;
+    u32 i;
+    for(i = 0; i < count; ++i)
+    {   mask |= mm->modifiers[keycodes[i]];
+    }
+    return mask;
 }
 
+/* Loads the modifier mapping if MappingNotify changed it, and derives the masks again if the keymap changed.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+static int
+_xcb_modmap_load(XCBDisplay *display, _XCBModmap *mm)
+{
+    xcb_get_modifier_mapping_reply_t *reply;
+    XCBGenericError *err = NULL;
+    const XCBKeyCode *keycodes;
+    u32 i;
+
+    if(mm->loaded && !mm->dirty && !mm->stale)
+    {   return 1;
+    }
+    if(!mm->loaded || mm->dirty)
+    {
+        reply = xcb_get_modifier_mapping_reply(display, xcb_get_modifier_mapping(display), &err);
+        if(err)
+        {
+            _xcb_err_handler(display, err);
+            free(reply);
+            return 0;
+        }
+        if(!reply)
+        {   return 0;
+        }
+        memset(mm->modifiers, 0, sizeof(mm->modifiers));
+        keycodes = xcb_get_modifier_mapping_keycodes(reply);
+        for(i = 0; i < 8u * reply->keycodes_per_modifier; ++i)
+        {
+            if(keycodes[i])
+            {   mm->modifiers[keycodes[i]] |= 1 << (i / reply->keycodes_per_modifier);
+            }
+        }
+        free(reply);
+        mm->dirty = 0;
+    }
+    mm->stale = 0;
+    mm->num_lock = _xcb_modmap_mask(display, mm, 0xff7f /* XK_Num_Lock */);
+    mm->scroll_lock = _xcb_modmap_mask(display, mm, 0xff14 /* XK_Scroll_Lock */);
+    mm->mode_switch = _xcb_modmap_mask(display, mm, 0xff7e /* XK_Mode_switch */);
+    mm->loaded = 1;
+    return 1;
+}
 
 int
-XCBDisplayKeyCodes(XCBDisplay *display, int *min_keycode_return, int *max_keycode_return)
+XCBKeymapGetModifierMasks(
+        XCBDisplay *display,
+        XCBModifierMasks *masks_return
+        )
 {
-    const XCBSetup *setup = xcb_get_setup(display);
-    *min_keycode_return = setup->min_keycode;
-    *max_keycode_return = setup->max_keycode;
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    _XCBModmap *mm;
+    if(!dd || !_xcb_modmap_load(display, &dd->modmap))
+    {   return 0;
+    }
+    mm = &dd->modmap;
+    masks_return->num_lock = mm->num_lock;
+    masks_return->scroll_lock = mm->scroll_lock;
+    masks_return->mode_switch = mm->mode_switch;
+    masks_return->locks = XCB_MOD_MASK_LOCK | mm->num_lock | mm->scroll_lock;
     return 1;
 }
 
-int 
-XCBDisplayKeycodes(XCBDisplay *display, int *min_keycode_return, int *max_keycode_return)
+u16
+XCBKeymapGetModifiers(
+        XCBDisplay *display,
+        XCBKeyCode keycode
+        )
 {
-    const XCBSetup *setup = xcb_get_setup(display);
-    *min_keycode_return = setup->min_keycode;
-    *max_keycode_return = setup->max_keycode;
-    return 1;
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    if(!dd || !_xcb_modmap_load(display, &dd->modmap))
+    {   return 0;
+    }
+    return dd->modmap.modifiers[keycode];
 }
 
 XCBKeyCode *
 XCBGetKeyCodes(XCBDisplay *display, XCBKeysym keysym)
 {
-    xcb_key_symbols_t *keysyms;
-	xcb_keycode_t *keycode;
-
-	if (!(keysyms = xcb_key_symbols_alloc(display)))
-		return NULL;
-
-	keycode = xcb_key_symbols_get_keycode(keysyms, keysym);
-	xcb_key_symbols_free(keysyms);
-
-	return keycode;
+    XCBKeyCode keycodes[256];
+    XCBKeyCode *ret;
+    const u32 count = XCBKeymapGetKeycodes(display, keysym, keycodes, 256);
+    if(!count)
+    {   return NULL;
+    }
+    ret = malloc((count + 1) * sizeof(XCBKeyCode));
+    if(ret)
+    {
+        memcpy(ret, keycodes, count * sizeof(XCBKeyCode));
+        ret[count] = XCB_NO_SYMBOL;
+    }
+    return ret;
 }
 
 XCBKeycode *
@@ -1538,12 +7904,92 @@ XCBGetKeyboardMappingReply(XCBDisplay *display, XCBCookie cookie)
     return reply;
 }
 
+XCBCookie
+XCBGetModifierMappingCookie(XCBDisplay *display)
+{
+    const xcb_get_modifier_mapping_cookie_t cookie = xcb_get_modifier_mapping(display);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+XCBKeyboardModifier *
+XCBGetModifierMappingReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    const xcb_get_modifier_mapping_cookie_t cookie1 = { .sequence = cookie.sequence };
+    XCBKeyboardModifier *reply = xcb_get_modifier_mapping_reply(display, cookie1, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+XCBCookie
+XCBXineramaIsActiveCookie(XCBDisplay *display)
+{
+    const xcb_xinerama_is_active_cookie_t cookie = xcb_xinerama_is_active(display);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+XCBXineramaIsActive *
+XCBXineramaIsActiveReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    const xcb_xinerama_is_active_cookie_t cookie1 = { .sequence = cookie.sequence };
+    XCBXineramaIsActive *reply = xcb_xinerama_is_active_reply(display, cookie1, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+XCBCookie
+XCBXineramaQueryScreensCookie(XCBDisplay *display)
+{
+    const xcb_xinerama_query_screens_cookie_t cookie = xcb_xinerama_query_screens(display);
+    return (XCBCookie) { .sequence = cookie.sequence };
+}
+
+XCBXineramaQueryScreens *
+XCBXineramaQueryScreensReply(XCBDisplay *display, XCBCookie cookie)
+{
+    XCBGenericError *err = NULL;
+    const xcb_xinerama_query_screens_cookie_t cookie1 = { .sequence = cookie.sequence };
+    XCBXineramaQueryScreens *reply = xcb_xinerama_query_screens_reply(display, cookie1, &err);
+    if(err)
+    {   
+        _xcb_err_handler(display, err);
+        if(reply)
+        {   free(reply);
+        }
+        return NULL;
+    }
+    return reply;
+}
+
+XCBXineramaScreenInfo *
+XCBXineramaQueryScreensInfo(XCBXineramaQueryScreens *reply, int *length_return)
+{
+    *length_return = xcb_xinerama_query_screens_screen_info_length(reply);
+    return xcb_xinerama_query_screens_screen_info(reply);
+}
+
 XCBCookie
 XCBQueryTreeCookie(
         XCBDisplay *display,
         XCBWindow window
         )
 {
+    _xcb_cfg_before(display);
     const xcb_query_tree_cookie_t cookie = xcb_query_tree(display, window);
     return (XCBCookie) { .sequence = cookie.sequence };
 }
@@ -1576,6 +8022,7 @@ XCBQueryTreeChildren(const XCBQueryTree *tree)
 XCBCookie
 XCBQueryPointerCookie(XCBDisplay *display, XCBWindow window)
 {
+    _xcb_cfg_before(display);
     const xcb_query_pointer_cookie_t cookie = xcb_query_pointer(display, window);
     return (XCBCookie) { .sequence = cookie.sequence };
 }
@@ -1601,6 +8048,7 @@ XCBQueryPointerReply(XCBDisplay *display, XCBCookie cookie)
 XCBCookie
 XCBMapWindow(XCBDisplay *display, XCBWindow window)
 {
+    _xcb_cfg_before(display);
 #if DBG
     XCBCookie cookie = xcb_map_window_checked(display, window);
     ck(display, cookie, _fn);
@@ -1617,6 +8065,7 @@ XCBUnmapWindow(
         XCBWindow window
         )
 {
+    _xcb_cfg_before(display);
 #if DBG
     XCBCookie cookie = xcb_unmap_window_checked(display, window);
     ck(display, cookie, _fn);
@@ -1632,6 +8081,18 @@ XCBDestroyWindow(
         XCBWindow window
         )
 {
+    _XCBDisplayData *dd = _xcb_dpy(display);
+    void **slot;
+    if(dd && (slot = _xcb_map_get(&dd->configs.windows, window)))
+    {
+        free(*slot);
+        _xcb_map_del(&dd->configs.windows, window);
+    }
+    if(dd && dd->props.enabled)
+    {   _xcb_prop_forget(&dd->props, window, XCB_NONE);
+    }
+    /* its own held configure is dropped above, its descendants ones must not come after it is gone */
+    _xcb_cfg_before(display);
 #if DBG
     XCBCookie cookie = xcb_destroy_window_checked(display, window);
     ck(display, cookie, _fn);
@@ -1751,16 +8212,70 @@ XCBSetLineAttributes(XCBDisplay *display, XCBGC gc, u32 linewidth, u32 linestyle
     return 1;
 }
 
+/* RETURN: Bytes of payload (a multiple of 4) that fit in 1 request after header units, at least bytes if all of it does. */
+static u64
+_xcb_request_room(XCBDisplay *display, u32 header, u64 bytes)
+{
+    u64 max = xcb_get_setup(display)->maximum_request_length;
+    /* the common case, checked first so BIG-REQUESTS (a round trip if not prefetched) is only asked for when needed */
+    if(header + (bytes + 3) / 4 <= max)
+    {   return bytes;
+    }
+    max = xcb_get_maximum_request_length(display);
+    /* 1 unit for the BIG-REQUESTS length */
+    return max > header + 1 ? (max - header - 1) * 4 : 0;
+}
+
 XCBCookie
 XCBChangeProperty(XCBDisplay *display, XCBWindow window, XCBAtom property, XCBAtom type, u8 format, u8 mode, const void *data, u32 nelements)
 {
+    const u8 *bytes = data;
+    const u32 size = format / 8;
+    XCBCookie cookie;
+    u64 room;
+    u32 start;
+    u32 n;
+
+    /* sizeof(xcb_change_property_request_t) / 4 */
+    room = size ? _xcb_request_room(display, 6, (u64)nelements * size) / size : nelements;
+    if(nelements <= room || !room)
+    {
 #if DBG
-    XCBCookie cookie = xcb_change_property_checked(display, mode, window, property, type, format, nelements, data);
-    ck(display, cookie, _fn);
-    return cookie;
+        cookie = xcb_change_property_checked(display, mode, window, property, type, format, nelements, data);
+        ck(display, cookie, _fn);
+        return cookie;
 #endif
-
-    return xcb_change_property(display, mode, window, property, type, format, nelements, data);
+        return xcb_change_property(display, mode, window, property, type, format, nelements, data);
+    }
+    if(mode == XCB_PROP_MODE_PREPEND)
+    {
+        /* last chunk first so they end up in order */
+        for(start = nelements; start; )
+        {
+            n = start < room ? start : room;
+            start -= n;
+#if DBG
+            cookie = xcb_change_property_checked(display, mode, window, property, type, format, n, bytes + (size_t)start * size);
+            ck(display, cookie, _fn);
+#else
+            cookie = xcb_change_property(display, mode, window, property, type, format, n, bytes + (size_t)start * size);
+#endif
+        }
+        return cookie;
+    }
+    for(start = 0; start < nelements; start += n)
+    {
+        n = nelements - start < room ? nelements - start : room;
+#if DBG
+        cookie = xcb_change_property_checked(display, mode, window, property, type, format, n, bytes + (size_t)start * size);
+        ck(display, cookie, _fn);
+#else
+        cookie = xcb_change_property(display, mode, window, property, type, format, n, bytes + (size_t)start * size);
+#endif
+        /* Replace only once */
+        mode = XCB_PROP_MODE_APPEND;
+    }
+    return cookie;
 }
 
 XCBCookie
@@ -1782,6 +8297,24 @@ XCBConfigureWindow(
         u16 value_mask,
         XCBWindowChanges *changes)
 {
+    const u32 fields[7] = 
+    {   
+        changes->x, changes->y, changes->width, changes->height, 
+        changes->border_width, changes->sibling, changes->stack_mode 
+    };
+    u32 values[7];
+    u32 count;
+    u32 i;
+    for(i = count = 0; i < 7; ++i)
+    {
+        if(value_mask & (1 << i))
+        {   values[count++] = fields[i];
+        }
+    }
+    XCBCookie taken;
+    if(_xcb_cfg_take(display, window, value_mask, values, &taken))
+    {   return taken;
+    }
 #if DBG
     XCBCookie cookie = xcb_configure_window_aux_checked(display, window, value_mask, changes);
     ck(display, cookie, _fn);
@@ -1816,16 +8349,84 @@ XCBChangeGC(XCBDisplay *display, XCBGC gc, u32 valuemask, const void *valuelist)
     return xcb_change_gc(display, gc, valuemask, valuelist);
 }
 
+/* PolyPoint of points with first sent in place of points[0], no copy is made.
+ * Used to start a split XCB_COORD_MODE_PREVIOUS run from its absolute position.
+ */
+static XCBCookie
+_xcb_poly_point_from(XCBDisplay *display, int checked, u8 coordinatemode, XCBDrawable drawable, XCBGC gc, 
+        const XCBPoint *first, const XCBPoint *points, u32 points_len)
+{
+    static const xcb_protocol_request_t req = { .count = 4, .ext = NULL, .opcode = XCB_POLY_POINT, .isvoid = 1 };
+    /* xcb_send_request() needs 2 spare in front */
+    struct iovec parts[6];
+    xcb_poly_point_request_t out = { .coordinate_mode = coordinatemode, .drawable = drawable, .gc = gc };
+    parts[2].iov_base = &out;
+    parts[2].iov_len = sizeof(out);
+    parts[3].iov_base = (void *)first;
+    parts[3].iov_len = sizeof(XCBPoint);
+    parts[4].iov_base = (void *)(points + 1);
+    parts[4].iov_len = (points_len - 1) * sizeof(XCBPoint);
+    parts[5].iov_base = NULL;
+    parts[5].iov_len = 0;
+    return (XCBCookie){ .sequence = xcb_send_request(display, checked ? XCB_REQUEST_CHECKED : 0, parts + 2, &req) };
+}
+
 XCBCookie
 XCBDrawPoint(XCBDisplay *display, u8 coordinatemode, XCBDrawable drawable, XCBGC gc, uint32_t points_len, XCBPoint *points)
 {
+    XCBCookie cookie;
+    XCBPoint first;
+    i16 x = 0;
+    i16 y = 0;
+    u64 room;
+    u32 start;
+    u32 n;
+    u32 i;
+
+    /* sizeof(xcb_poly_point_request_t) / 4 */
+    room = _xcb_request_room(display, 3, (u64)points_len * sizeof(XCBPoint)) / sizeof(XCBPoint);
+    if(points_len <= room || !room)
+    {
 #if DBG
-    XCBCookie cookie = xcb_poly_point_checked(display, coordinatemode, drawable, gc, points_len, points);
-    ck(display, cookie, _fn);
-    return cookie;
+        cookie = xcb_poly_point_checked(display, coordinatemode, drawable, gc, points_len, points);
+        ck(display, cookie, _fn);
+        return cookie;
 #endif
-
-    return xcb_poly_point(display, coordinatemode, drawable, gc, points_len, points);
+        return xcb_poly_point(display, coordinatemode, drawable, gc, points_len, points);
+    }
+    for(start = 0; start < points_len; start += n)
+    {
+        n = points_len - start < room ? points_len - start : room;
+        if(coordinatemode == XCB_COORD_MODE_PREVIOUS && start)
+        {
+            first.x = x + points[start].x;
+            first.y = y + points[start].y;
+#if DBG
+            cookie = _xcb_poly_point_from(display, 1, coordinatemode, drawable, gc, &first, points + start, n);
+            ck(display, cookie, _fn);
+#else
+            cookie = _xcb_poly_point_from(display, 0, coordinatemode, drawable, gc, &first, points + start, n);
+#endif
+        }
+        else
+        {
+#if DBG
+            cookie = xcb_poly_point_checked(display, coordinatemode, drawable, gc, n, points + start);
+            ck(display, cookie, _fn);
+#else
+            cookie = xcb_poly_point(display, coordinatemode, drawable, gc, n, points + start);
+#endif
+        }
+        if(coordinatemode == XCB_COORD_MODE_PREVIOUS)
+        {
+            for(i = start; i < start + n; ++i)
+            {
+                x = x + points[i].x;
+                y = y + points[i].y;
+            }
+        }
+    }
+    return cookie;
 }
 
 int
@@ -2098,3 +8699,251 @@ XCBGetWMNormalHintsReply(
     }
     return status;
 }
+
+/* requests per window in XCBScanTree(), in the order they are sent */
+#define _XCB_SCAN_REQUESTS      8
+/* longs asked for of _NET_WM_STATE and _NET_WM_WINDOW_TYPE */
+#define _XCB_SCAN_MAX_ATOMS     64
+
+/* RETURN: Where an array of size bytes goes in the scan block, NULL if base is NULL (measuring only). */
+static void *
+_xcb_scan_place(u8 *base, size_t *offset, size_t size)
+{
+    void *ret;
+    *offset = (*offset + 7) & ~(size_t)7;
+    ret = base ? base + *offset : NULL;
+    *offset += size;
+    return ret;
+}
+
+/* Lays out every array of scan after the struct itself.
+ *
+ * RETURN: Size of the block.
+ */
+static size_t
+_xcb_scan_layout(XCBTreeScan *scan, u8 *base, u32 count, u32 atoms, size_t strings, char **strings_return)
+{
+    size_t offset = sizeof(XCBTreeScan);
+    scan->windows = _xcb_scan_place(base, &offset, count * sizeof(XCBWindow));
+    scan->wm_hints = _xcb_scan_place(base, &offset, count * sizeof(XCBWMHints));
+    scan->size_hints = _xcb_scan_place(base, &offset, count * sizeof(XCBSizeHints));
+    scan->instance_name = _xcb_scan_place(base, &offset, count * sizeof(const char *));
+    scan->class_name = _xcb_scan_place(base, &offset, count * sizeof(const char *));
+    scan->transient_for = _xcb_scan_place(base, &offset, count * sizeof(XCBWindow));
+    scan->state_index = _xcb_scan_place(base, &offset, count * sizeof(u32));
+    scan->state_count = _xcb_scan_place(base, &offset, count * sizeof(u32));
+    scan->type_index = _xcb_scan_place(base, &offset, count * sizeof(u32));
+    scan->type_count = _xcb_scan_place(base, &offset, count * sizeof(u32));
+    scan->atoms = _xcb_scan_place(base, &offset, atoms * sizeof(XCBAtom));
+    scan->x = _xcb_scan_place(base, &offset, count * sizeof(i16));
+    scan->y = _xcb_scan_place(base, &offset, count * sizeof(i16));
+    scan->width = _xcb_scan_place(base, &offset, count * sizeof(u16));
+    scan->height = _xcb_scan_place(base, &offset, count * sizeof(u16));
+    scan->border_width = _xcb_scan_place(base, &offset, count * sizeof(u16));
+    scan->window_class = _xcb_scan_place(base, &offset, count * sizeof(u16));
+    scan->valid = _xcb_scan_place(base, &offset, count * sizeof(u8));
+    scan->map_state = _xcb_scan_place(base, &offset, count * sizeof(u8));
+    scan->override_redirect = _xcb_scan_place(base, &offset, count * sizeof(u8));
+    *strings_return = _xcb_scan_place(base, &offset, strings);
+    return offset;
+}
+
+/* RETURN: Number of atoms in reply, 0 if its not a list of atoms. */
+static u32
+_xcb_scan_atoms(const xcb_get_property_reply_t *reply)
+{
+    if(!reply || reply->type != XCB_ATOM_ATOM || reply->format != 32)
+    {   return 0;
+    }
+    return xcb_get_property_value_length(reply) / sizeof(XCBAtom);
+}
+
+XCBTreeScan *
+XCBScanTree(
+        XCBDisplay *display,
+        XCBWindow root
+        )
+{
+    static const char *const names[2] = { "_NET_WM_STATE", "_NET_WM_WINDOW_TYPE" };
+    XCBAtom net[2];
+    xcb_query_tree_cookie_t treecookie;
+    xcb_query_tree_reply_t *tree;
+    xcb_get_window_attributes_reply_t *attr;
+    xcb_get_geometry_reply_t *geom;
+    xcb_get_property_reply_t *prop;
+    XCBGenericError *err = NULL;
+    XCBTreeScan layout;
+    XCBTreeScan *scan = NULL;
+    XCBWindow *children;
+    void **replies = NULL;
+    void **r;
+    u32 *sequences = NULL;
+    u32 *seq;
+    char *strings;
+    size_t stringslen = 0;
+    size_t len;
+    u32 atomslen = 0;
+    u32 count;
+    u32 i;
+    u32 j;
+    u64 tree_ns;
+    u64 send_ns;
+    u64 wait_ns;
+    u64 start = _xcb_time_ns();
+
+    _xcb_cfg_before(display);
+    treecookie = xcb_query_tree(display, root);
+    /* a atom that doesnt exist cant be set on any window, so those requests can be skipped */
+    XCBInternAtoms(display, names, 2, 1, net);
+    tree = xcb_query_tree_reply(display, treecookie, &err);
+    if(!tree)
+    {   
+        free(err);
+        return NULL;
+    }
+    count = xcb_query_tree_children_length(tree);
+    children = xcb_query_tree_children(tree);
+    tree_ns = _xcb_time_ns() - start;
+
+    start = _xcb_time_ns();
+    sequences = malloc((count * _XCB_SCAN_REQUESTS + 1) * sizeof(u32));
+    replies = calloc(count * _XCB_SCAN_REQUESTS + 1, sizeof(void *));
+    if(!sequences || !replies)
+    {   goto CLEANUP;
+    }
+    for(i = 0; i < count; ++i)
+    {
+        seq = sequences + i * _XCB_SCAN_REQUESTS;
+        seq[0] = xcb_get_window_attributes(display, children[i]).sequence;
+        seq[1] = xcb_get_geometry(display, children[i]).sequence;
+        seq[2] = xcb_icccm_get_wm_hints(display, children[i]).sequence;
+        seq[3] = xcb_icccm_get_wm_normal_hints(display, children[i]).sequence;
+        seq[4] = xcb_icccm_get_wm_class(display, children[i]).sequence;
+        seq[5] = xcb_icccm_get_wm_transient_for(display, children[i]).sequence;
+        for(j = 0; j < 2; ++j)
+        {
+            if(net[j])
+            {   seq[6 + j] = xcb_get_property(display, 0, children[i], net[j], XCB_ATOM_ATOM, 0, _XCB_SCAN_MAX_ATOMS).sequence;
+            }
+        }
+    }
+    send_ns = _xcb_time_ns() - start;
+
+    start = _xcb_time_ns();
+    xcb_flush(display);
+    for(i = 0; i < count; ++i)
+    {
+        seq = sequences + i * _XCB_SCAN_REQUESTS;
+        r = replies + i * _XCB_SCAN_REQUESTS;
+        for(j = 0; j < _XCB_SCAN_REQUESTS; ++j)
+        {
+            if(j >= 6 && !net[j - 6])
+            {   continue;
+            }
+            err = NULL;
+            /* windows going away mid scan is expected, so errors are just dropped */
+            r[j] = xcb_wait_for_reply(display, seq[j], &err);
+            free(err);
+        }
+        /* strings are copied as "instance\0class\0", the extra 2 bytes terminate a badly formed one */
+        prop = r[4];
+        if(prop && prop->type == XCB_ATOM_STRING && prop->format == 8)
+        {   stringslen += xcb_get_property_value_length(prop) + 2;
+        }
+        atomslen += _xcb_scan_atoms(r[6]) + _xcb_scan_atoms(r[7]);
+    }
+    wait_ns = _xcb_time_ns() - start;
+
+    start = _xcb_time_ns();
+    scan = calloc(1, _xcb_scan_layout(&layout, NULL, count, atomslen, stringslen, &strings));
+    if(!scan)
+    {   goto CLEANUP;
+    }
+    _xcb_scan_layout(scan, (u8 *)scan, count, atomslen, stringslen, &strings);
+    scan->count = count;
+    scan->tree_ns = tree_ns;
+    scan->send_ns = send_ns;
+    scan->wait_ns = wait_ns;
+    scan->requests = count * (6 + !!net[0] + !!net[1]);
+    atomslen = 0;
+    for(i = 0; i < count; ++i)
+    {
+        r = replies + i * _XCB_SCAN_REQUESTS;
+        scan->windows[i] = children[i];
+        scan->instance_name[i] = "";
+        scan->class_name[i] = "";
+        if((attr = r[0]))
+        {
+            scan->map_state[i] = attr->map_state;
+            scan->override_redirect[i] = attr->override_redirect;
+            scan->window_class[i] = attr->_class;
+            scan->valid[i] |= XCB_SCAN_ATTRIBUTES;
+        }
+        if((geom = r[1]))
+        {
+            scan->x[i] = geom->x;
+            scan->y[i] = geom->y;
+            scan->width[i] = geom->width;
+            scan->height[i] = geom->height;
+            scan->border_width[i] = geom->border_width;
+            scan->valid[i] |= XCB_SCAN_GEOMETRY;
+        }
+        if(r[2] && xcb_icccm_get_wm_hints_from_reply(&scan->wm_hints[i], r[2]))
+        {   scan->valid[i] |= XCB_SCAN_WM_HINTS;
+        }
+        if(r[3] && xcb_icccm_get_wm_size_hints_from_reply(&scan->size_hints[i], r[3]))
+        {   scan->valid[i] |= XCB_SCAN_WM_NORMAL_HINTS;
+        }
+        prop = r[4];
+        if(prop && prop->type == XCB_ATOM_STRING && prop->format == 8)
+        {
+            len = xcb_get_property_value_length(prop);
+            memcpy(strings, xcb_get_property_value(prop), len);
+            strings[len] = '\0';
+            strings[len + 1] = '\0';
+            scan->instance_name[i] = strings;
+            scan->class_name[i] = strings + strnlen(strings, len) + 1;
+            strings += len + 2;
+            scan->valid[i] |= XCB_SCAN_WM_CLASS;
+        }
+        if(r[5] && xcb_icccm_get_wm_transient_for_from_reply(&scan->transient_for[i], r[5]))
+        {   scan->valid[i] |= XCB_SCAN_WM_TRANSIENT_FOR;
+        }
+        if(r[6] && ((xcb_get_property_reply_t *)r[6])->type == XCB_ATOM_ATOM)
+        {
+            scan->state_index[i] = atomslen;
+            scan->state_count[i] = _xcb_scan_atoms(r[6]);
+            memcpy(scan->atoms + atomslen, xcb_get_property_value(r[6]), scan->state_count[i] * sizeof(XCBAtom));
+            atomslen += scan->state_count[i];
+            scan->valid[i] |= XCB_SCAN_NET_WM_STATE;
+        }
+        if(r[7] && ((xcb_get_property_reply_t *)r[7])->type == XCB_ATOM_ATOM)
+        {
+            scan->type_index[i] = atomslen;
+            scan->type_count[i] = _xcb_scan_atoms(r[7]);
+            memcpy(scan->atoms + atomslen, xcb_get_property_value(r[7]), scan->type_count[i] * sizeof(XCBAtom));
+            atomslen += scan->type_count[i];
+            scan->valid[i] |= XCB_SCAN_NET_WM_WINDOW_TYPE;
+        }
+    }
+    scan->decode_ns = _xcb_time_ns() - start;
+CLEANUP:
+    if(replies)
+    {
+        for(i = 0; i < count * _XCB_SCAN_REQUESTS; ++i)
+        {   free(replies[i]);
+        }
+    }
+    free(replies);
+    free(sequences);
+    free(tree);
+    return scan;
+}
+
+void
+XCBFreeTreeScan(
+        XCBTreeScan *scan
+        )
+{
+    free(scan);
+}
@@ -6,7 +6,7 @@
 /* compiling
  * xcb is dumb and sometimes doesnt find the required stuff so you just guess or search it up
  * but this shhould cover most if not all of xcb's libraries, atleast the ones used here
- * `pkg-config --cflags --libs xcb` -lxcb-util -lxcb-icccm -lxcb-keysyms
+ * `pkg-config --cflags --libs xcb` -lxcb-util -lxcb-icccm -lxcb-keysyms -lxcb-xinerama -lxcb-randr
  */
 
 
@@ -48,6 +48,7 @@
  * NOTE: These functions only LOCK the display NOT the current thread.
  * XCBLockDisplay();    // Analagous to pthread_mutex_lock
  * XCBUnlockDisplay();  // Analagous to pthread_mutex_unlock
+ * NOTE: Worker threads can batch requests on their own and write them under the lock, see XCBStageChangeProperty().
  *
  *
  * xcb has a async way of handling stuff so when you call a function to do something async, unless you poll for reply nothing will happen.
@@ -343,6 +344,18 @@
                                                  * Instead it is recommended to disable this to allow for optimizations.
                                                  * It is also further recommended not not use a error handler as this will print out the info already.
                                                  */
+#define XCB_TRL_ENABLE_DEFERRED_CHECK 0         /* Only with XCB_TRL_ENABLE_DEBUG.
+                                                 * Instead of checking every request as its made (1 round trip each),
+                                                 * remember the sequence, function and time and match errors back to them as they arrive.
+                                                 * Errors are reported from the event functions, XCBSync() and XCBCloseDisplay().
+                                                 */
+#define XCB_TRL_ENABLE_ATOM_CACHE   0           /* This enables a per server atom cache file in $XDG_RUNTIME_DIR.
+                                                 * Atoms learned by XCBInternAtoms() are written out at XCBCloseDisplay()
+                                                 * and mapped back in at XCBOpenDisplay(), so later processes dont need to ask again.
+                                                 * The file is keyed by display name, vendor, release and the server socket,
+                                                 * and checked with a single GetAtomName the first time atoms are used.
+                                                 * Does nothing if $XDG_RUNTIME_DIR is not set.
+                                                 */
 
 
 
@@ -399,6 +412,22 @@ typedef xcb_grab_keyboard_reply_t XCBGrabKeyboard;
 typedef xcb_grab_pointer_reply_t XCBGrabPointer;
 typedef xcb_void_cookie_t XCBCookie;
 typedef struct XCBCookie64 XCBCookie64;
+typedef struct XCBCoalesceStats XCBCoalesceStats;
+typedef struct XCBWindowState XCBWindowState;
+typedef struct XCBTreeScan XCBTreeScan;
+typedef struct XCBPropertyChunk XCBPropertyChunk;
+typedef struct XCBCachedProperty XCBCachedProperty;
+typedef struct XCBModifierMasks XCBModifierMasks;
+typedef struct XCBMonitor XCBMonitor;
+typedef struct XCBMonitors XCBMonitors;
+/* Opaque, see XCBCreateBatch() */
+typedef struct XCBBatch XCBBatch;
+/* Opaque, see XCBCreateEventLoop() */
+typedef struct XCBEventLoop XCBEventLoop;
+/* Opaque, see XCBCreateDispatcher() */
+typedef struct XCBDispatcher XCBDispatcher;
+/* Opaque, see XCBCreateGrabSet() */
+typedef struct XCBGrabSet XCBGrabSet;
 typedef xcb_get_keyboard_mapping_reply_t XCBKeyboardMapping;
 typedef xcb_get_modifier_mapping_reply_t XCBKeyboardModifier;
 typedef xcb_colormap_t XCBColormap;
@@ -485,6 +514,7 @@ typedef xcb_keycode_t XCBKeycode;
 typedef xcb_keycode_t XCBKeyCode;
 
 typedef xcb_visualid_t XCBVisual;
+typedef xcb_visualtype_t XCBVisualType;
 
 
 /* array of characters NEVER use as char */
@@ -562,6 +592,22 @@ typedef xcb_selection_notify_event_t XCBSelectionNotifyEvent;
 typedef xcb_selection_request_event_t XCBSelectionRequestEvent;
 /* This is NOT short for XCBGenericEvent rather is used for Ge Events */
 typedef xcb_ge_event_t XCBGeEvent;
+/* See XCBSetReplyCallback() */
+typedef void (*XCBReplyCallback)(XCBDisplay *display, void *reply, XCBGenericError *error, void *data);
+/* See XCBSetIOErrorHandler(), error is the XCBHasConnectionError() code */
+typedef void (*XCBIOErrorHandler)(XCBDisplay *display, int error);
+/* See XCBCreateEventLoop(), event is freed after the call returns */
+typedef void (*XCBEventLoopEventCallback)(XCBEventLoop *loop, XCBGenericEvent *event, void *data);
+/* See XCBEventLoopAddFd(), events are the EPOLL* bits that woke it */
+typedef void (*XCBEventLoopFdCallback)(XCBEventLoop *loop, int fd, uint32_t events, void *data);
+/* See XCBEventLoopAddTimer(), expirations is how many times it went off since the last call */
+typedef void (*XCBEventLoopTimerCallback)(XCBEventLoop *loop, int timer, uint64_t expirations, void *data);
+/* See XCBSetEventHandler() */
+typedef void (*XCBEventHandler)(XCBDisplay *display, XCBGenericEvent *event, void *data);
+/* See XCBReadProperty(), return nonzero to stop reading */
+typedef int (*XCBPropertyChunkCallback)(XCBDisplay *display, const XCBPropertyChunk *chunk, void *data);
+/* See XCBSetDispatchTimingHook(), nanoseconds is how long the handler of event took */
+typedef void (*XCBDispatchTimingHook)(XCBDispatcher *dispatcher, const XCBGenericEvent *event, uint64_t nanoseconds, void *data);
 
 
 /* structs */
@@ -569,6 +615,78 @@ struct XCBCookie64
 {   uint64_t sequence;
 };
 
+/* See XCBSetEventCoalescing() */
+struct XCBCoalesceStats
+{
+    uint64_t received;      /* events read from the server */
+    uint64_t delivered;     /* events handed back to the caller */
+    uint64_t motion;        /* MotionNotify merged into a later one */
+    uint64_t configure;     /* ConfigureNotify replaced by a later one */
+    uint64_t expose;        /* Expose unioned into the last of its series */
+};
+
+/* See XCBReadProperty() */
+struct XCBPropertyChunk
+{
+    XCBAtom type;
+    uint8_t format;
+    uint32_t offset;        /* bytes of the property before data */
+    uint32_t length;        /* bytes in data */
+    uint32_t total;         /* bytes in the property */
+    const void *data;
+};
+
+/* See XCBGetCachedProperty() */
+struct XCBCachedProperty
+{
+    XCBAtom type;           /* XCB_NONE if the property doesnt exist */
+    uint8_t format;
+    uint32_t length;        /* items of format bits, same as XCBGetWindowPropertyValueLength() */
+    const void *value;
+};
+
+/* See XCBKeymapGetModifierMasks() */
+struct XCBModifierMasks
+{
+    uint16_t num_lock;      /* XCB_MOD_MASK_(...) of the modifiers Num_Lock is on, 0 if none */
+    uint16_t scroll_lock;
+    uint16_t mode_switch;
+    uint16_t locks;         /* XCB_MOD_MASK_LOCK | num_lock | scroll_lock */
+};
+
+/* See XCBTrackMonitors() */
+struct XCBMonitor
+{
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    XCBAtom name;           /* RandR monitor name, XCB_NONE otherwise */
+    uint8_t primary;
+};
+
+/* See XCBGetMonitors() */
+struct XCBMonitors
+{
+    uint32_t count;
+    uint32_t serial;        /* changes on every rebuild */
+    uint8_t source;         /* XCB_MONITORS_* */
+    const XCBMonitor *monitors;
+};
+
+/* See XCBMirrorWindows() */
+struct XCBWindowState
+{
+    XCBWindow parent;
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t border_width;
+    uint8_t map_state;          /* XCB_MAP_STATE_* */
+    uint8_t override_redirect;
+};
+
 
 /* macros */
 enum
@@ -655,14 +773,16 @@ XCBDisplayNumber(
 int 
 XCBConnectionNumber(
         XCBDisplay *display);
-/*
- * 
+/* Gets the screen from the screen table, built once per display from the setup (no walking the screen list).
+ *
+ * RETURN: XCBScreen * on Success.
+ * RETURN: NULL on Failure (screen out of range).
  */
 XCBScreen *
 XCBScreenOfDisplay(
         XCBDisplay *display, 
         int scren);
-/*
+/* Same as XCBScreenOfDisplay().
  */
 XCBScreen *
 XCBDefaultScreenOfDisplay(
@@ -734,6 +854,8 @@ XCBGetScreen(
 /*
  * These are useful with functions that need a drawable of a particular screen and for creating top-level windows.
  * return the root window. 
+ *
+ * NOTE: The getters below index the screen table, a screen out of range returns 0.
  */
 XCBWindow 
 XCBRootWindow(
@@ -765,6 +887,31 @@ uint8_t
 XCBDefaultDepth(
         XCBDisplay *display, 
         int screen);
+
+/* return the visual of the root window of screen.
+ */
+XCBVisual
+XCBDefaultVisual(
+        XCBDisplay *display,
+        int screen);
+
+/* Finds a visual by id, through an index of every visual of every screen built with the screen table.
+ *
+ * depth_return:    Optional, depth of the visual.
+ * screen_return:   Optional, screen the visual is on.
+ *
+ * NOTE: Points into the setup, valid until the display is closed, DO NOT free().
+ *
+ * RETURN: XCBVisualType * on Success.
+ * RETURN: NULL on Failure (no such visual).
+ */
+XCBVisualType *
+XCBFindVisualType(
+        XCBDisplay *display,
+        XCBVisual visual,
+        uint8_t *depth_return,
+        int *screen_return
+        );
 XCBCookie
 XCBSelectInput(
         XCBDisplay *display, 
@@ -845,6 +992,33 @@ XCBSyncf(
         XCBDisplay *display
         );
 
+/* Keeps a shadow of every configured windows geometry (x, y, width, height, border_width) and holds geometry changes back,
+ * so configuring the same window many times before the next flush sends at most 1 ConfigureWindow for it,
+ * and setting something to what it already is sends nothing.
+ * Applies to XCBMoveWindow(), XCBResizeWindow(), XCBMoveResizeWindow(), XCBSetWindowBorderWidth() and XCBConfigureWindow().
+ *
+ * enable:      1/true/True         Cache configures.
+ *              0/false/False       Send configures right away (default), anything held back is sent now.
+ *
+ * NOTE: Held back configures are sent by XCBFlush(), XCBSync(), XCBCloseDisplay() and XCBEventLoop, raw xcb_flush() does not send them.
+ * NOTE: Stacking changes (XCBRaiseWindow() and co.) send what is held back first, so ordering between windows is kept.
+ *       So do XCBMapWindow(), XCBMapRaised(), XCBUnmapWindow(), XCBDestroyWindow(), XCBSendEvent(), XCBFlushStaged(),
+ *       the geometry, attribute, tree and pointer queries,
+ *       and the mirror and tree scans, anything else sent with raw xcb can overtake them.
+ * NOTE: The shadow only ever comes from ConfigureNotify events read through this API,
+ *       a window without StructureNotifyMask (or SubstructureNotifyMask on its parent) selected never has a change dropped as a no op.
+ *       A notify generated before the last configure sent to that window is ignored.
+ * NOTE: A configure the cache takes returns a cookie with sequence 0.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBSetConfigureCache(
+        XCBDisplay *display,
+        int enable
+        );
+
 XCBCookie
 XCBMoveWindow(
         XCBDisplay *display, 
@@ -852,6 +1026,10 @@ XCBMoveWindow(
         int32_t x, 
         int32_t y);
 
+/* Moves and resizes window in a single ConfigureWindow request.
+ *
+ * RETURN: Cookie to request.
+ */
 XCBCookie
 XCBMoveResizeWindow(
         XCBDisplay *display, 
@@ -923,6 +1101,122 @@ XCBInternAtomReply(
         XCBDisplay *display, 
         XCBCookie cookie);
 
+/* Interns every name in names, atoms are remembered per display so repeat lookups never touch the server.
+ * Every name not already known is sent in 1 burst and only then are the replies collected,
+ * so the cost is at most 1 round trip no matter how many names.
+ *
+ * names:           Array of count names, NULL entries are skipped and return XCB_NONE.
+ * only_if_exists:  0/false/False           Create the atom if it doesnt exist.
+ *                  1/true/True             Dont create the atom, XCB_NONE is returned for it instead.
+ * atoms_return:    Array of count atoms, filled in the same order as names.
+ *
+ * NOTE: Names that failed (or didnt exist) are NOT remembered and are asked again next time.
+ *
+ * RETURN: Number of atoms resolved (non XCB_NONE).
+ */
+uint32_t
+XCBInternAtoms(
+        XCBDisplay *display,
+        const char *const *names,
+        uint32_t count,
+        int only_if_exists,
+        XCBAtom *atoms_return
+        );
+
+/* Same as XCBInternAtoms() for a single name.
+ *
+ * NOTE: This blocks if the atom isnt known, use XCBInternAtoms() to get many at once.
+ *
+ * RETURN: XCBAtom on Success.
+ * RETURN: XCB_NONE on Failure.
+ */
+XCBAtom
+XCBInternAtom(
+        XCBDisplay *display,
+        const char *name,
+        int only_if_exists
+        );
+
+/* Looks up a atom by name from memory only, this never sends a request.
+ *
+ * NOTE: With XCB_TRL_ENABLE_ATOM_CACHE the first call may wait on the cache spot check sent by XCBOpenDisplay().
+ *
+ * RETURN: XCBAtom if known.
+ * RETURN: XCB_NONE if not known.
+ */
+XCBAtom
+XCBLookupAtom(
+        XCBDisplay *display,
+        const char *name
+        );
+
+/* Looks up the name of a atom from memory only, this never sends a request.
+ * Predefined atoms (XCB_ATOM_(...)) are always known.
+ *
+ * NOTE: Returned string is owned by the display and should NOT be freed.
+ * NOTE: Returned string is valid until XCBCloseDisplay().
+ *
+ * RETURN: Name if known.
+ * RETURN: NULL if not known.
+ */
+const char *
+XCBLookupAtomName(
+        XCBDisplay *display,
+        XCBAtom atom
+        );
+
+XCBCookie
+XCBGetAtomNameCookie(
+        XCBDisplay *display,
+        XCBAtom atom);
+
+/*
+ *
+ * NOTE: reply must be freed by caller.
+ *
+ * RETURN: Null terminated name on Success.
+ * RETURN: NULL on Failure.
+ */
+char *
+XCBGetAtomNameReply(
+        XCBDisplay *display,
+        XCBCookie cookie);
+
+/* Gets the name of atom, asking the server only if it isnt already known.
+ * Names are remembered in the same table XCBInternAtoms() uses, so either direction fills both.
+ *
+ * NOTE: This blocks if the atom isnt known, use XCBGetAtomNames() to get many at once.
+ * NOTE: Returned string is owned by the display and should NOT be freed.
+ * NOTE: Returned string is valid until XCBCloseDisplay().
+ *
+ * RETURN: Name on Success.
+ * RETURN: NULL on Failure.
+ */
+const char *
+XCBGetAtomName(
+        XCBDisplay *display,
+        XCBAtom atom
+        );
+
+/* Gets the name of every atom in atoms, asking the server only for the ones not already known.
+ * Requests are sent in 1 burst and flushed once before any reply is read, duplicates share a request.
+ *
+ * atoms:           Array of count atoms, XCB_NONE entries return NULL.
+ * names_return:    Array of count names, filled in the same order as atoms.
+ *
+ * NOTE: Returned strings are owned by the display and should NOT be freed.
+ * NOTE: Returned strings are valid until XCBCloseDisplay().
+ *
+ * RETURN: Number of names resolved (non NULL).
+ */
+uint32_t
+XCBGetAtomNames(
+        XCBDisplay *display,
+        const XCBAtom *atoms,
+        uint32_t count,
+        const char **names_return
+        );
+
 
 XCBCookie
 XCBGetTransientForHintCookie(
@@ -1035,6 +1329,93 @@ XCBGetWindowPropertyValueLength(
         XCBWindowProperty *reply, size_t size
         );
 
+/* Reads a property of any size in chunks, for the likes of _NET_WM_ICON and WM_COMMAND.
+ * The first reply's bytes_after sizes the rest, which are then kept depth requests in flight,
+ * so only depth chunks are ever held at once and the read costs about total / (chunk_length * 4 * depth) round trips.
+ *
+ * req_type:        XCB_ATOM_(...)          Type wanted, XCB_GET_PROPERTY_TYPE_ANY for any.
+ * chunk_length:    X                       Longs (4 bytes) per request, 0 for default (64KiB).
+ * depth:           X                       Requests in flight, 0 for default (4).
+ * callback:        Called once per chunk in offset order, the chunk is only valid during the call.
+ *
+ * NOTE: A property that changes while being read is a Failure, chunks already given to callback stay given.
+ * NOTE: A property that doesnt exist (or isnt req_type) is a Failure, callback is never called.
+ * NOTE: A empty property is 1 chunk of length 0.
+ *
+ * RETURN: 1 on Success (or when callback stopped it).
+ * RETURN: 0 on Failure.
+ */
+int
+XCBReadProperty(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        XCBAtom req_type,
+        uint32_t chunk_length,
+        uint32_t depth,
+        XCBPropertyChunkCallback callback,
+        void *data
+        );
+
+/* XCBReadProperty() into buffer, reading stops once buffer is full.
+ *
+ * length_return:   Bytes in the property, only size of them are copied if its larger.
+ *
+ * NOTE: buffer may be partly written on Failure, the *_return are not.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBReadPropertyInto(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        XCBAtom req_type,
+        void *buffer,
+        uint32_t size,
+        XCBAtom *type_return,
+        uint8_t *format_return,
+        uint32_t *length_return
+        );
+
+/* Caches properties per (window, property, req_type) in up to max_bytes, least recently used are evicted first.
+ * Entries are dropped by the PropertyNotify and DestroyNotify events read through this API,
+ * so only windows with PropertyChange selected are cached, checked in the same round trip as a miss on a window with nothing cached.
+ *
+ * max_bytes:       Memory cap (values plus bookkeeping), 0 disables the cache and drops everything in it.
+ *
+ * NOTE: Changing the event mask of a window through XCBSelectInput() or XCBChangeWindowAttributes() relearns it.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBSetPropertyCache(
+        XCBDisplay *display,
+        size_t max_bytes
+        );
+
+/* Gets the whole of a property, from the cache if there, otherwise from the server (1 round trip) caching the value.
+ * A hit makes no request and no allocation.
+ *
+ * NOTE: The cache must be enabled with XCBSetPropertyCache() to cache anything, otherwise this is a plain fetch.
+ * NOTE: prop_return->value is owned by the display and valid until the next XCBGetCachedProperty() or XCBCloseDisplay(),
+ *       whatever drops it from the cache meanwhile (events, XCBSelectInput(), XCBDestroyWindow(), XCBSetPropertyCache()) leaves it alone until then.
+ * NOTE: A property that doesnt exist is cached as well, with a type of XCB_NONE.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBGetCachedProperty(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBAtom property,
+        XCBAtom req_type,
+        XCBCachedProperty *prop_return
+        );
+
 XCBCookie
 XCBGetWindowAttributesCookie(
         XCBDisplay *display, 
@@ -1219,6 +1600,79 @@ int
 XCBFlush(
         XCBDisplay *display);
 
+/* Locks display for the calling thread, other threads calling XCBLockDisplay() wait until it is unlocked.
+ * The lock is recursive, every XCBLockDisplay() needs its XCBUnlockDisplay().
+ *
+ * NOTE: This only serializes threads that lock, it does not make the rest of this API thread safe on its own.
+ * NOTE: XCBFlushStaged() takes this lock to write, so requests made while holding it never land inside a staged batch.
+ */
+void
+XCBLockDisplay(
+        XCBDisplay *display);
+
+void
+XCBUnlockDisplay(
+        XCBDisplay *display);
+
+/* Stages a ChangeProperty request in a buffer owned by the calling thread, nothing is sent until XCBFlushStaged().
+ * Worker threads can build requests without ever touching the connection (or its lock),
+ * the whole batch is then written in 1 go under XCBLockDisplay().
+ *
+ * Parameters are the same as XCBChangeProperty(), nelements being in format units.
+ *
+ * NOTE: The request must fit in the maximum request length without BIG-REQUESTS.
+ * NOTE: At most 65534 requests can be staged per XCBFlushStaged().
+ *
+ * RETURN: Ticket (index in this threads batch) on Success, sequence is XCBFlushStaged() first_return + ticket.
+ * RETURN: UINT32_MAX on Failure.
+ */
+uint32_t
+XCBStageChangeProperty(
+        XCBDisplay *display,
+        XCBWindow window,
+        uint8_t mode,
+        XCBAtom property,
+        XCBAtom type,
+        uint8_t format,
+        uint32_t nelements,
+        const void *data
+        );
+
+/* Stages a ConfigureWindow request, see XCBStageChangeProperty().
+ *
+ * value_mask:      XCB_CONFIG_WINDOW_* bits.
+ * values:          One value per bit set, in bit order.
+ *
+ * RETURN: Ticket on Success.
+ * RETURN: UINT32_MAX on Failure.
+ */
+uint32_t
+XCBStageConfigureWindow(
+        XCBDisplay *display,
+        XCBWindow window,
+        uint16_t value_mask,
+        const uint32_t *values
+        );
+
+/* Writes every request the calling thread staged on display, emptying its stage.
+ * The batch is written as 1 writev() after libxcb's own buffer, preceded by a GetInputFocus whose reply is discarded.
+ *
+ * first_return:    Sequence of ticket 0, the sequence of any ticket is first_return->sequence + ticket.
+ *                  Errors for them come in as events (they are unchecked) with that full_sequence.
+ *
+ * NOTE: Threads sending while the batch is written wait for it (libxcb asks for the socket back first),
+ *       so first_return->sequence is exact even for threads that do not hold XCBLockDisplay().
+ * NOTE: Like XCBFlush() this does not wait for the server.
+ *
+ * RETURN: Number of requests written on Success.
+ * RETURN: 0 on Failure (nothing staged, or connection error).
+ */
+uint32_t
+XCBFlushStaged(
+        XCBDisplay *display,
+        XCBCookie64 *first_return
+        );
+
 /*
  * Gets the maximum data that a XCBDisplay* can hold in bytes / 4.
  * Ex: 4 bytes size would return 1
@@ -1303,12 +1757,79 @@ XCBHasDisplayError(
 int 
 XCBSetErrorHandler(void (*error_handler)(XCBDisplay *, XCBGenericError *));
 
+/* Stores errors from this API in a fixed size ring on display instead of calling the error handler.
+ * The ring is preallocated, errors are copied in by value and read back in batches with XCBDrainErrors(),
+ * so a storm of errors (say a client dying with hundreds of requests in flight) costs nothing extra.
+ * Errors of unchecked requests, which come in as events (response_type 0), go to the ring too
+ * and are never handed out by XCBNextEvent(), XCBPollForEvent() and co.
+ *
+ * enable:      1/true/True         Errors go to the ring.
+ *              0/false/False       Errors go to the error handler (default), error events are handed out as events.
+ *
+ * NOTE: The ring holds 256 errors, anything past that is dropped and counted, see XCBGetErrorRingStats().
+ * NOTE: Any number of threads may store (by reading replies or events), stores take a lock of their own.
+ *       Only 1 thread at a time may call XCBDrainErrors(), it never waits on a store.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBSetErrorRing(
+        XCBDisplay *display,
+        int enable
+        );
+
+/* Limits how many errors of error_code are let through per second, the rest are dropped and counted.
+ * This applies to the error ring and the error handler alike.
+ *
+ * per_second:  0 is unlimited (default).
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBSetErrorRateLimit(
+        XCBDisplay *display,
+        uint8_t error_code,
+        uint16_t per_second
+        );
+
+/* Copies up to max errors out of the error ring, oldest first.
+ *
+ * RETURN: Number of errors copied into errors_return.
+ */
+uint32_t
+XCBDrainErrors(
+        XCBDisplay *display,
+        XCBGenericError *errors_return,
+        uint32_t max
+        );
+
+/* dropped_return:      Errors lost because the ring was full.
+ * suppressed_return:   Errors lost to XCBSetErrorRateLimit().
+ *
+ * NOTE: No side effects if either is NULL.
+ */
+void
+XCBGetErrorRingStats(
+        XCBDisplay *display,
+        uint32_t *dropped_return,
+        uint32_t *suppressed_return
+        );
+
 
-/* not implemented */
+/* Sets the function called once display's connection breaks (XCBHasConnectionError() becomes non zero).
+ * It is checked whenever the event functions or an XCBEventLoop come up empty.
+ *
+ * IOHandler:   Function to call, NULL to unset.
+ *
+ * NOTE: display is unusable by the time the handler runs, about the only thing left to do is XCBCloseDisplay().
+ *       Closing it is left to the caller, the handler should not do it from inside an XCBEventLoop.
+ */
 void 
 XCBSetIOErrorHandler(
         XCBDisplay *display, 
-        void *IOHandler);
+        XCBIOErrorHandler IOHandler);
 
 
 /* Returns Bad(The error) using a number provided.
@@ -1468,6 +1989,8 @@ XCBSendEvent(
  * event_return: XCBGenericError * on Error.
  * event_return: NULL on I/O Error.
  *
+ * NOTE: Reply callbacks that come due while waiting are run here, see XCBSetReplyCallback().
+ *
  * RETURN: 1 On Success.
  * RETURN: 0 On Failure.
  */
@@ -1480,6 +2003,8 @@ XCBNextEvent(
  * This returns a structure called xcb_generic_event_t.
  * This Function Blocks until a request is received.
  *
+ * NOTE: Reply callbacks that come due while waiting are run here, see XCBSetReplyCallback().
+ *
  * RETURN: XCBGenericEvent * on Success.
  * RETURN: XCBGenericError * on Error.
  * RETURN: NULL on I/O Error.
@@ -1500,6 +2025,7 @@ XCBWaitForEvent(
  * shut down when this function returns.
  *
  * NOTE: XCBGenericEvent event_type
+ * NOTE: Reply callbacks that already came due are run here, see XCBSetReplyCallback().
  */
 
 XCBGenericEvent *
@@ -1522,43 +2048,541 @@ XCBPollForEvent(
 XCBGenericEvent *
 XCBPollForQueuedEvent(
         XCBDisplay *display);
-/* Check if a specified cookie request has a reply available from the XServer.
- * 
- * RETURN: 1 On Success.
- * RETURN: 0 On Not Avaible.
- */
-int 
-XCBPollForReply(
-        XCBDisplay *display, 
-        XCBCookie request, 
-        void **reply_return);
-/* Check if a specified cookie request has a reply available from the XServer.
- * This is different from XCBPollForReply() as it assumes the request has already be widened.
+
+/* Takes every event available right now (as XCBPollForEvent() would) in one call, copying them into events_return.
+ * Since the copies are fixed size, the libxcb allocations are freed here and the caller has nothing to free.
+ * Any GenericEvent (XCB_GE_GENERIC) payload past the first 32 bytes is kept in a side buffer, see XCBGetEventPayload().
  *
- * RETURN: 1 On Success.
- * RETURN: 0 On Not Avaible/Failure.
- */
-int 
-XCBPollForReply64(
-        XCBDisplay *display, 
-        XCBCookie request, 
-        void **reply);
-/* Check if a specified cookie request has a reply available from the XServer.
- * 
- * RETURN: void * On Success.
- * RETURN: NULL On Not Avaible/Failure.
- */
-void *
-XCBCheckReply(
-        XCBDisplay *display, 
-        XCBCookie request);
-/* Check if a specified cookie request has a reply available from the XServer.
- * This is different from XCBCheckReply() as it assumes the request has already be widened.
+ * events_return:       Array of at least max slots.
+ * max:                 Most events to take, anything past it is left for the next call.
  *
- * NOTE: Casting a XCBCookie as a XCBCookie64 is not a safe operation.
+ * NOTE: Does not block.
+ * NOTE: Event coalescing and reply callbacks apply the same as with XCBPollForEvent().
  *
- * RETURN: void * On Success.
- * RETURN: NULL On not Avaible/Failure.
+ * RETURN: Number of events written to events_return.
+ */
+uint32_t
+XCBPollForEvents(
+        XCBDisplay *display,
+        XCBGenericEvent *events_return,
+        uint32_t max
+        );
+
+/* Finds the extra data of a GenericEvent taken by the last XCBPollForEvents() call.
+ * The returned data is laid out as it would be past full_sequence in the libxcb event,
+ * its size being ((XCBGeEvent *)&events_return[index])->length * 4.
+ *
+ * index:               Slot in the events_return of the last XCBPollForEvents().
+ *
+ * NOTE: Valid until the next XCBPollForEvents() or XCBCloseDisplay().
+ *
+ * RETURN: Pointer to the payload on Success.
+ * RETURN: NULL on Failure (not a GenericEvent, or it had no extra data).
+ */
+const void *
+XCBGetEventPayload(
+        XCBDisplay *display,
+        uint32_t index
+        );
+
+/* Reduces the events handed back by XCBNextEvent(), XCBWaitForEvent() and XCBPollForEvent().
+ * Every time the caller runs out of events, everything already read is taken at once and:
+ * - Consecutive MotionNotify for the same window are merged into the last one.
+ * - Only the last ConfigureNotify per window is kept, in the place of the last one.
+ * - Expose series are unioned (bounding box) per window into a single Expose with count 0.
+ * Everything else, and any synthetic (send_event) event, is passed through untouched and in order.
+ *
+ * enable:      1/true/True         Coalesce events.
+ *              0/false/False       Hand back every event (default), already reduced events are still delivered first.
+ *
+ * NOTE: A Expose series is held back until its count 0 event arrives.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBSetEventCoalescing(
+        XCBDisplay *display,
+        int enable
+        );
+
+/* Mirrors the state of root and its children on the client, so their geometry and map state are memory reads.
+ * Seeded with 1 QueryTree and 1 pipelined round of GetWindowAttributes/GetGeometry,
+ * then kept current by the CreateNotify, ConfigureNotify, MapNotify, UnmapNotify, DestroyNotify and ReparentNotify
+ * events read through this API (XCBNextEvent() and co., XCBPollForEvents(), XCBEventLoop).
+ *
+ * NOTE: The caller must select SubstructureNotify on root (and StructureNotify on anything else it wants kept), 
+ *       or the mirror goes stale.
+ * NOTE: Windows reparented away from a mirrored parent are still kept, windows created under an unmirrored one are not.
+ * NOTE: Calling it again drops the current mirror and seeds a new one.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBMirrorWindows(
+        XCBDisplay *display,
+        XCBWindow root
+        );
+
+/* Drops the mirror, see XCBMirrorWindows(). */
+void
+XCBStopMirror(
+        XCBDisplay *display
+        );
+
+/* Looks up window in the mirror, no request is made.
+ *
+ * NOTE: No side effects on Failure.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (window is not mirrored).
+ */
+int
+XCBMirrorLookup(
+        XCBDisplay *display,
+        XCBWindow window,
+        XCBWindowState *state_return
+        );
+
+/* Checks every mirrored window against the server (1 round trip), correcting the mirror.
+ *
+ * NOTE: Only meaningful with no events left to read, an event still queued is held for the next event function and the check is skipped.
+ *
+ * RETURN: Number of windows that differed on Success.
+ * RETURN: -1 on Failure (or skipped).
+ */
+int
+XCBMirrorVerify(
+        XCBDisplay *display
+        );
+
+/* Debugging aid, runs XCBMirrorVerify() from XCBEventLoopDispatch() whenever interval_ms has passed,
+ * printing every window that differed to stderr.
+ *
+ * interval_ms:     Time between checks, 0 turns it off (default).
+ *
+ * NOTE: The event functions never run it, a client without XCBEventLoop calls XCBMirrorVerify() itself.
+ */
+void
+XCBSetMirrorSelfCheck(
+        XCBDisplay *display,
+        uint32_t interval_ms
+        );
+
+/* XCBMonitors.source */
+enum
+{
+    XCB_MONITORS_SCREEN = 0,        /* neither extension had monitors, the whole root window */
+    XCB_MONITORS_XINERAMA = 1,
+    XCB_MONITORS_RANDR = 2,
+};
+
+/* Tracks the monitor topology of root, so placement lookups are memory reads.
+ * Fetched in 1 pipelined round (RandR 1.5 GetMonitors and Xinerama QueryScreens together, RandR preferred),
+ * kept as a snapshot indexed by monitor edges, so XCBMonitorAtPoint() is 2 binary searches.
+ * RandR ScreenChangeNotify and RRNotify events (selected here) read through this API mark the snapshot stale,
+ * it is fetched again on the next XCBRefreshMonitors(), and only then.
+ *
+ * NOTE: Without RandR nothing is notified, selecting StructureNotify on root makes root ConfigureNotify count instead.
+ * NOTE: Calling it again drops the current snapshot and fetches a new one.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBTrackMonitors(
+        XCBDisplay *display,
+        XCBWindow root
+        );
+
+/* Stops tracking monitors, see XCBTrackMonitors(). */
+void
+XCBStopMonitors(
+        XCBDisplay *display
+        );
+
+/* Gets the current monitor snapshot, as is, even if the monitors changed since, see XCBRefreshMonitors().
+ *
+ * NOTE: Valid until the next XCBRefreshMonitors() that rebuilds it, XCBTrackMonitors() or XCBStopMonitors(),
+ *       compare serial to see if it was rebuilt.
+ *
+ * RETURN: XCBMonitors * on Success.
+ * RETURN: NULL on Failure (not tracking).
+ */
+const XCBMonitors *
+XCBGetMonitors(
+        XCBDisplay *display
+        );
+
+/* Fetches the monitors again if they changed since the snapshot, the only place a snapshot is rebuilt.
+ *
+ * NOTE: A rebuild frees the old snapshot, pointers from XCBGetMonitors() before it are invalid after it.
+ *
+ * RETURN: 1 on Success (the snapshot is current).
+ * RETURN: 0 on Failure (not tracking, or the fetch failed and the old snapshot is kept).
+ */
+int
+XCBRefreshMonitors(
+        XCBDisplay *display
+        );
+
+/* Checks for a monitor change since the snapshot, without fetching anything.
+ *
+ * RETURN: 1 if the next XCBRefreshMonitors() fetches the monitors again.
+ * RETURN: 0 otherwise.
+ */
+int
+XCBMonitorsChanged(
+        XCBDisplay *display
+        );
+
+/* Gets the monitor x, y is on, the first of them for clones.
+ *
+ * monitors:        A snapshot from XCBGetMonitors().
+ *
+ * RETURN: Index into monitors->monitors on Success.
+ * RETURN: -1 on Failure (on no monitor).
+ */
+int
+XCBMonitorAtPoint(
+        const XCBMonitors *monitors,
+        int16_t x,
+        int16_t y
+        );
+
+/* Gets the monitor a rectangle overlaps the most, the monitor of its centre if all of it is on that.
+ *
+ * monitors:        A snapshot from XCBGetMonitors().
+ *
+ * RETURN: Index into monitors->monitors on Success.
+ * RETURN: -1 on Failure (on no monitor).
+ */
+int
+XCBMonitorForRect(
+        const XCBMonitors *monitors,
+        int16_t x,
+        int16_t y,
+        uint16_t width,
+        uint16_t height
+        );
+
+/* Starts a thread that does nothing but read events off display into a ring,
+ * after which the event functions take events from the ring without any syscalls,
+ * only sleeping (on an eventfd) when the ring is empty.
+ *
+ * size:            Ring size in events, rounded up to a power of 2, 0 for the default (1024).
+ *
+ * NOTE: While running the reader thread owns display's event queue, raw xcb_poll_for_event()/xcb_wait_for_event() must not be used.
+ * NOTE: The reader stops reading while the ring is full.
+ * NOTE: Blocking event functions wake only for events, reply callbacks (XCBSetReplyCallback()) are run as events come in or through XCBDispatchReplies().
+ * NOTE: Creates a 1x1 InputOnly window, never mapped, used to stop the thread.
+ * NOTE: XCBEventLoop waits on XCBEventThreadFd() instead of the connection on its own.
+ *
+ * RETURN: 1 on Success (or already running).
+ * RETURN: 0 on Failure.
+ */
+int
+XCBStartEventThread(
+        XCBDisplay *display,
+        uint32_t size
+        );
+
+/* Stops the reader thread, waiting for it to exit.
+ * Events it already read are still handed out first, after that events are read directly again.
+ *
+ * NOTE: Called by XCBCloseDisplay().
+ */
+void
+XCBStopEventThread(
+        XCBDisplay *display
+        );
+
+/* Gets the fd to wait on (POLLIN) for events while a reader thread runs, in place of XCBConnectionNumber().
+ *
+ * NOTE: It only becomes readable when the ring goes from empty to not, take every event each wakeup.
+ *
+ * RETURN: eventfd on Success.
+ * RETURN: -1 on Failure (no reader thread).
+ */
+int
+XCBEventThreadFd(
+        XCBDisplay *display
+        );
+
+/* Fills stats_return with how many events were coalesced since XCBOpenDisplay().
+ *
+ * NOTE: stats_return is zeroed on Failure.
+ */
+void
+XCBGetCoalesceStats(
+        XCBDisplay *display,
+        XCBCoalesceStats *stats_return
+        );
+
+/* Creates an epoll based loop around display's connection, waking only when there is something to do.
+ * Other fds and timers (timerfd) can be added to the same loop, see XCBEventLoopAddFd() and XCBEventLoopAddTimer().
+ * Every wakeup of the connection hands all events read to callback and runs reply callbacks (XCBSetReplyCallback()).
+ *
+ * callback:        Called for each event.
+ * data:            Passed along to callback.
+ *
+ * NOTE: The loop flushes display before it sleeps.
+ * NOTE: Errors are handed to callback like they are with XCBPollForEvent().
+ *
+ * RETURN: XCBEventLoop * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBEventLoop *
+XCBCreateEventLoop(
+        XCBDisplay *display,
+        XCBEventLoopEventCallback callback,
+        void *data
+        );
+
+/* Frees loop, closing every timer but none of the fds added with XCBEventLoopAddFd().
+ *
+ * NOTE: Must not be called from a callback of loop.
+ */
+void
+XCBFreeEventLoop(
+        XCBEventLoop *loop
+        );
+
+/* RETURN: Display loop was created with. */
+XCBDisplay *
+XCBEventLoopDisplay(
+        XCBEventLoop *loop
+        );
+
+/* Watches fd in loop.
+ *
+ * events:          EPOLL* bits to wait for, EPOLLIN for most.
+ * callback:        Called with the bits that were ready.
+ *
+ * NOTE: fd stays owned by the caller, remove it with XCBEventLoopRemoveFd() before closing it.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBEventLoopAddFd(
+        XCBEventLoop *loop,
+        int fd,
+        uint32_t events,
+        XCBEventLoopFdCallback callback,
+        void *data
+        );
+
+/* Stops watching fd, callback will not be called for it again even in the current wakeup.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (fd was not added).
+ */
+int
+XCBEventLoopRemoveFd(
+        XCBEventLoop *loop,
+        int fd
+        );
+
+/* Adds a timer to loop.
+ *
+ * timeout_ms:      Milliseconds until it first goes off, 0 is treated as 1.
+ * interval_ms:     Milliseconds between repeats, 0 for a one shot.
+ *
+ * NOTE: A one shot timer stays in loop until removed, it just never goes off again.
+ *
+ * RETURN: Timer id on Success, also passed to the callback.
+ * RETURN: -1 on Failure.
+ */
+int
+XCBEventLoopAddTimer(
+        XCBEventLoop *loop,
+        uint32_t timeout_ms,
+        uint32_t interval_ms,
+        XCBEventLoopTimerCallback callback,
+        void *data
+        );
+
+/* Removes and closes a timer added with XCBEventLoopAddTimer().
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (timer was not added).
+ */
+int
+XCBEventLoopRemoveTimer(
+        XCBEventLoop *loop,
+        int timer
+        );
+
+/* Waits once for anything in loop to be ready and runs its callbacks.
+ *
+ * timeout_ms:      Most to wait, -1 waits until something happens, 0 does not wait.
+ *
+ * RETURN: Number of callbacks run (0 on timeout) on Success.
+ * RETURN: -1 on Failure (connection error, see XCBSetIOErrorHandler(), or epoll failed).
+ */
+int
+XCBEventLoopDispatch(
+        XCBEventLoop *loop,
+        int timeout_ms
+        );
+
+/* Runs XCBEventLoopDispatch() until XCBEventLoopStop() is called or it fails.
+ *
+ * RETURN: 0 when stopped.
+ * RETURN: -1 on Failure.
+ */
+int
+XCBEventLoopRun(
+        XCBEventLoop *loop
+        );
+
+/* Makes XCBEventLoopRun() return once the current dispatch finishes, safe to call from any callback of loop. */
+void
+XCBEventLoopStop(
+        XCBEventLoop *loop
+        );
+
+/* Creates a table of event handlers, replacing the usual switch on XCB_EVENT_RESPONSE_TYPE().
+ * Core (and non GenericEvent extension) events are looked up by response type in a flat table,
+ * GenericEvents by their extension opcode and event type in a hash table.
+ *
+ * NOTE: Starts empty, events without a handler go to the default handler if any, see XCBSetDefaultEventHandler().
+ *
+ * RETURN: XCBDispatcher * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBDispatcher *
+XCBCreateDispatcher(
+        XCBDisplay *display
+        );
+
+void
+XCBFreeDispatcher(
+        XCBDispatcher *dispatcher
+        );
+
+/* Sets the handler of response_type, synthetic (send_event) events included.
+ *
+ * response_type:   0 for errors, XCB_KEY_PRESS...127 for events, extension event bases count as well.
+ * handler:         Function to call, NULL to unset.
+ *
+ * NOTE: XCB_GE_GENERIC events only go here when no handler matches in XCBSetGenericEventHandler().
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (response_type over 127).
+ */
+int
+XCBSetEventHandler(
+        XCBDispatcher *dispatcher,
+        uint8_t response_type,
+        XCBEventHandler handler,
+        void *data
+        );
+
+/* Sets the handler of a GenericEvent (XCB_GE_GENERIC).
+ *
+ * extension:       Major opcode of the extension (xcb_ge_generic_event_t.extension).
+ * event_type:      Event type within extension (xcb_ge_generic_event_t.event_type).
+ * handler:         Function to call, NULL to unset.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBSetGenericEventHandler(
+        XCBDispatcher *dispatcher,
+        uint8_t extension,
+        uint16_t event_type,
+        XCBEventHandler handler,
+        void *data
+        );
+
+/* Sets the handler for events no other handler takes, NULL to drop those. */
+void
+XCBSetDefaultEventHandler(
+        XCBDispatcher *dispatcher,
+        XCBEventHandler handler,
+        void *data
+        );
+
+/* Calls hook with the time every handler took, NULL to turn it off (default).
+ *
+ * NOTE: Costs two clock_gettime() calls per event while set.
+ */
+void
+XCBSetDispatchTimingHook(
+        XCBDispatcher *dispatcher,
+        XCBDispatchTimingHook hook,
+        void *data
+        );
+
+/* Runs the handler of event.
+ *
+ * NOTE: event is not freed.
+ *
+ * RETURN: 1 on Success (a handler ran).
+ * RETURN: 0 on Failure (no handler).
+ */
+int
+XCBDispatchEvent(
+        XCBDispatcher *dispatcher,
+        XCBGenericEvent *event
+        );
+
+/* Runs the handlers of count events, as taken by XCBPollForEvents(), grouped by handler:
+ * every event for one handler runs back to back, in order, before the next handler starts.
+ *
+ * NOTE: Events for different handlers are reordered, only use this where that does not matter.
+ * NOTE: Handlers are grouped in order of their first event in the batch.
+ * NOTE: The slot of an event (for XCBGetEventPayload()) is event - events.
+ *
+ * RETURN: Number of events a handler ran for.
+ */
+uint32_t
+XCBDispatchEvents(
+        XCBDispatcher *dispatcher,
+        XCBGenericEvent *events,
+        uint32_t count
+        );
+/* Check if a specified cookie request has a reply available from the XServer.
+ * 
+ * RETURN: 1 On Success.
+ * RETURN: 0 On Not Avaible.
+ */
+int 
+XCBPollForReply(
+        XCBDisplay *display, 
+        XCBCookie request, 
+        void **reply_return);
+/* Check if a specified cookie request has a reply available from the XServer.
+ * This is different from XCBPollForReply() as it assumes the request has already be widened.
+ *
+ * RETURN: 1 On Success.
+ * RETURN: 0 On Not Avaible/Failure.
+ */
+int 
+XCBPollForReply64(
+        XCBDisplay *display, 
+        XCBCookie request, 
+        void **reply);
+/* Check if a specified cookie request has a reply available from the XServer.
+ * 
+ * RETURN: void * On Success.
+ * RETURN: NULL On Not Avaible/Failure.
+ */
+void *
+XCBCheckReply(
+        XCBDisplay *display, 
+        XCBCookie request);
+/* Check if a specified cookie request has a reply available from the XServer.
+ * This is different from XCBCheckReply() as it assumes the request has already be widened.
+ *
+ * NOTE: Casting a XCBCookie as a XCBCookie64 is not a safe operation.
+ *
+ * RETURN: void * On Success.
+ * RETURN: NULL On not Avaible/Failure.
  */
 void *
 XCBCheckReply64(
@@ -1590,6 +2614,176 @@ XCBWaitForReply64(
         XCBCookie64 cookie
         );
 
+/* Creates a batch, a list of cookies whose replies are collected all at once by XCBBatchDrain().
+ * Every request is sent as its added, XCBBatchDrain() then flushes once and waits for the replies in sequence order,
+ * so N requests cost 1 round trip instead of N.
+ *
+ * Usage:
+ *        XCBBatch *batch = XCBCreateBatch(display, count);
+ *        for(i = 0; i < count; ++i)
+ *        {   XCBBatchGetWindowAttributes(batch, windows[i], &attrs[i], &errs[i]);
+ *        }
+ *        XCBBatchDrain(batch);
+ *        // attrs[i] is NULL and errs[i].error_code is set for any window that failed.
+ *        XCBFreeBatch(batch);
+ *
+ * size_hint:       Expected number of cookies, 0 for default.
+ *
+ * RETURN: XCBBatch * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBBatch *
+XCBCreateBatch(
+        XCBDisplay *display,
+        uint32_t size_hint
+        );
+
+/* Frees a batch, any cookies not yet drained are discarded.
+ */
+void
+XCBFreeBatch(
+        XCBBatch *batch
+        );
+
+/* Adds a cookie to a batch.
+ *
+ * reply_return:    Where the reply is stored by XCBBatchDrain(), NULL is stored on failure.
+ *                  May be NULL if the reply isnt wanted (it is discarded instead).
+ * error_return:    Where a error is copied by XCBBatchDrain(), error_code is 0 if there was none.
+ *                  If NULL errors go to the error handler like every other _reply() instead.
+ *
+ * NOTE: Slots must stay valid until XCBBatchDrain() or XCBFreeBatch().
+ * NOTE: Cookies may be added in any order, they are still drained in sequence order.
+ * NOTE: The cookie must be for a request that has a reply.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (out of memory), the cookie is discarded.
+ */
+int
+XCBBatchAdd(
+        XCBBatch *batch,
+        XCBCookie cookie,
+        void **reply_return,
+        XCBGenericError *error_return
+        );
+
+/* XCBGetWindowAttributesCookie() added to batch, see XCBBatchAdd().
+ * NOTE: reply must be freed by caller.
+ */
+int
+XCBBatchGetWindowAttributes(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBGetWindowAttributes **reply_return,
+        XCBGenericError *error_return
+        );
+
+/* XCBGetWindowGeometryCookie() added to batch, see XCBBatchAdd().
+ * NOTE: reply must be freed by caller.
+ */
+int
+XCBBatchGetWindowGeometry(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBGeometry **reply_return,
+        XCBGenericError *error_return
+        );
+
+/* XCBGetWindowPropertyCookie() added to batch, see XCBBatchAdd().
+ * NOTE: reply must be freed by caller.
+ */
+int
+XCBBatchGetWindowProperty(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBAtom property,
+        uint32_t long_offset,
+        uint32_t long_length,
+        uint8_t _delete,
+        XCBAtom req_type,
+        XCBWindowProperty **reply_return,
+        XCBGenericError *error_return
+        );
+
+/* XCBQueryTreeCookie() added to batch, see XCBBatchAdd().
+ * NOTE: reply must be freed by caller.
+ */
+int
+XCBBatchQueryTree(
+        XCBBatch *batch,
+        XCBWindow window,
+        XCBQueryTree **reply_return,
+        XCBGenericError *error_return
+        );
+
+/* Flushes once and waits for every reply in batch, filling each slot given to XCBBatchAdd().
+ * The batch is empty afterwards and can be reused.
+ *
+ * RETURN: Number of slots that failed.
+ * RETURN: 0 on Success.
+ */
+uint32_t
+XCBBatchDrain(
+        XCBBatch *batch
+        );
+
+/* Registers callback to be called when the reply (or error) for cookie arrives, instead of waiting on it.
+ * Callbacks are run from XCBNextEvent(), XCBWaitForEvent(), XCBPollForEvent() and XCBDispatchReplies(),
+ * in sequence order, so a slow reply never holds up events behind it.
+ *
+ * callback:    reply:  The reply on Success, must be freed by callback. NULL on Failure.
+ *              error:  The error on Failure, freed after callback returns. NULL on Success.
+ *              data:   data as given.
+ *
+ * NOTE: The cookie must not be waited on or discarded by anything else.
+ * NOTE: Callbacks may register more callbacks.
+ * NOTE: Callbacks still pending at XCBCloseDisplay() are never called.
+ * NOTE: A cookie is widened against the previous one given (the first against the connections own 64 bit sequence),
+ *       so registering more than 2^31 requests after the last one is not safe, use XCBSetReplyCallback64() for those.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure (out of memory), the reply is discarded and callback is never called.
+ */
+int
+XCBSetReplyCallback(
+        XCBDisplay *display,
+        XCBCookie cookie,
+        XCBReplyCallback callback,
+        void *data
+        );
+
+/* Same as XCBSetReplyCallback() with a already widened cookie.
+ *
+ * NOTE: Casting a XCBCookie as a XCBCookie64 is not a safe operation.
+ */
+int
+XCBSetReplyCallback64(
+        XCBDisplay *display,
+        XCBCookie64 cookie,
+        XCBReplyCallback callback,
+        void *data
+        );
+
+/* Removes a callback registered by XCBSetReplyCallback(), its reply is discarded.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 if there was no callback for cookie.
+ */
+int
+XCBCancelReplyCallback(
+        XCBDisplay *display,
+        XCBCookie cookie
+        );
+
+/* Runs the callback of every reply that has already arrived, this never blocks.
+ *
+ * RETURN: Number of callbacks run.
+ */
+uint32_t
+XCBDispatchReplies(
+        XCBDisplay *display
+        );
+
 
 
 /* grabbing/grab */
@@ -1797,6 +2991,98 @@ XCBGrabButton(
         XCBWindow confine_to,
         XCBCursor cursor 
         );
+
+/* Creates a grab set, the key and button bindings of one window, grabbed for every combination of lock modifiers.
+ * A binding of one keysym is grabbed once per keycode the keysym is on, times once per combination of
+ * CapsLock, NumLock and ScrollLock, so it still triggers when any of those are on.
+ * XCBGrabSetApply() sends only what changed since the last apply, so call it again on every MappingNotify.
+ *
+ * Usage:
+ *        XCBGrabSet *set = XCBCreateGrabSet(display, root);
+ *        XCBGrabSetAddKey(set, XK_Return, XCB_MOD_MASK_4);
+ *        XCBGrabSetAddButton(set, XCB_BUTTON_INDEX_1, XCB_MOD_MASK_4, XCB_EVENT_MASK_BUTTON_PRESS, XCB_GRAB_MODE_ASYNC);
+ *        XCBGrabSetApply(set);
+ *        // On MappingNotify:
+ *        XCBRefreshKeyboardMapping(syms, event);
+ *        XCBGrabSetApply(set);
+ *
+ * RETURN: XCBGrabSet * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBGrabSet *
+XCBCreateGrabSet(
+        XCBDisplay *display,
+        XCBWindow grab_window
+        );
+
+/* Frees a grab set.
+ *
+ * NOTE: Grabs stay on the server, XCBGrabSetClear() then XCBGrabSetApply() first to release them.
+ */
+void
+XCBFreeGrabSet(
+        XCBGrabSet *set
+        );
+
+/* Adds a key binding, grabbed with owner_events set and both modes XCB_GRAB_MODE_ASYNC.
+ *
+ * modifiers:       XCB_MOD_MASK_(...)          Modifiers the binding needs, lock modifiers are added by XCBGrabSetApply().
+ *                  XCB_MOD_MASK_ANY            Grabbed once per keycode, no lock combinations.
+ *
+ * NOTE: Keysyms are resolved on XCBGrabSetApply(), a keysym on no keycode is skipped until it is.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBGrabSetAddKey(
+        XCBGrabSet *set,
+        XCBKeysym keysym,
+        uint16_t modifiers
+        );
+
+/* Adds a button binding, grabbed with owner_events set, keyboard_mode XCB_GRAB_MODE_ASYNC, no confine_to and no cursor.
+ *
+ * button:          XCB_BUTTON_INDEX_(...)      The button, XCB_BUTTON_INDEX_ANY for any.
+ * modifiers:       See XCBGrabSetAddKey().
+ * event_mask:      XCB_EVENT_MASK_(...)        Pointer events reported while grabbed, see XCBGrabButton().
+ * pointer_mode:    XCB_GRAB_MODE_(...)         See XCBGrabButton().
+ *
+ * NOTE: Adding the same button and modifiers again replaces its event_mask and pointer_mode.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBGrabSetAddButton(
+        XCBGrabSet *set,
+        uint8_t button,
+        uint16_t modifiers,
+        uint16_t event_mask,
+        uint8_t pointer_mode
+        );
+
+/* Removes every binding, the grabs are released on the next XCBGrabSetApply().
+ */
+void
+XCBGrabSetClear(
+        XCBGrabSet *set
+        );
+
+/* Grabs the bindings of set, diffed against the grabs the last apply left.
+ * Keysyms are resolved through XCBKeymapGetKeycodes(), lock modifiers through XCBKeymapGetModifierMasks().
+ * Grabs no longer wanted are released, new (or changed) ones are grabbed, the rest are left alone;
+ * all of it is sent in one burst and flushed.
+ *
+ * NOTE: No round trips, unless MappingNotify changed the keymap or modifier mapping since.
+ *
+ * RETURN: Number of XCBGrabKey()/XCBUngrabKey()/XCBGrabButton()/XCBUngrabButton() requests sent on Success.
+ * RETURN: -1 on Failure, nothing is sent and the last applied grabs are kept.
+ */
+int
+XCBGrabSetApply(
+        XCBGrabSet *set
+        );
 /*
  * grab_window:     XCBWindow                   Specifies the window on which the pointer should be grabbed.
  * owner_events:    1/true/True                 The grab_window will still get the pointer events
@@ -1878,24 +3164,79 @@ XCBDisplayKeycodes(
         int *min_keycode_return, 
         int *max_keycode_return);
 
-/* This gets the keycodes of the specfied display.
- *
- * NOTE: This operation is relativly expensive so it is recommended to not use this function;
- *       Instead it is recommended to use XCBKeySymbolsAlloc() and search them yourself.
+/* Gets the keycodes of keysym from the display keymap, see XCBKeymapGetKeycodes().
  *
  * NOTE: RETURN MUST BE RELEASED BY CALLER USING free().
+ *
+ * RETURN: Array of keycodes ending with XCB_NO_SYMBOL on Success.
+ * RETURN: NULL on Failure (or none found).
  */
 XCBKeycode *
 XCBGetKeycodes(XCBDisplay *display, XCBKeysym keysym);
-/* This gets the keycodes of the specfied display.
+/* Same as XCBGetKeycodes(). */
+XCBKeyCode *
+XCBGetKeyCodes(XCBDisplay *display, XCBKeysym keysym);
+
+/* Gets the keycodes of keysym from the keymap kept per display, without a request or allocation.
+ * The keymap is fetched once on first use and indexed by keysym, so a lookup is a hash probe.
+ * MappingNotify events read through this API mark the keycodes they name, only those are fetched again on the next lookup.
  *
- * NOTE: This operation is relativly expensive so it is recommended to not use this function.
- *       Instead it is recommended to use XCBKeySymbolsAlloc() and search them using XCBKeySymbolsGetKeyCode.
+ * keycodes_return: Array of max, filled in XCBKeySymbolsGetKeyCode() order (column then keycode) without duplicates.
  *
- * NOTE: RETURN MUST BE RELEASED BY CALLER USING free().
+ * NOTE: Columns follow XCBKeySymbolsGetKeySym(), case is only derived for Latin 1 keysyms.
+ *
+ * RETURN: Number of keycodes filled.
+ * RETURN: 0 on Failure (or none found).
  */
-XCBKeyCode *
-XCBGetKeyCodes(XCBDisplay *display, XCBKeysym keysym);
+uint32_t
+XCBKeymapGetKeycodes(
+        XCBDisplay *display,
+        XCBKeysym keysym,
+        XCBKeyCode *keycodes_return,
+        uint32_t max
+        );
+
+/* Gets the keysym at column of keycode from the display keymap, see XCBKeymapGetKeycodes().
+ *
+ * RETURN: XCBKeysym on Success.
+ * RETURN: XCB_NO_SYMBOL on Failure.
+ */
+XCBKeysym
+XCBKeymapGetKeysym(
+        XCBDisplay *display,
+        XCBKeyCode keycode,
+        uint8_t column
+        );
+
+/* Gets the masks of the lock and Mode_switch modifiers from the modifier mapping kept per display.
+ * The mapping is fetched once on first use, then again only after a MappingNotify for modifiers;
+ * a MappingNotify for the keyboard derives the masks again from the keymap (Num_Lock may have moved).
+ *
+ * Usage:
+ *        XCBKeymapGetModifierMasks(display, &masks);
+ *        state = event->state & ~masks.locks;
+ *
+ * NOTE: MappingNotify is only seen when events are read through this API.
+ *
+ * RETURN: 1 on Success.
+ * RETURN: 0 on Failure.
+ */
+int
+XCBKeymapGetModifierMasks(
+        XCBDisplay *display,
+        XCBModifierMasks *masks_return
+        );
+
+/* Gets the modifiers keycode is on, see XCBKeymapGetModifierMasks().
+ *
+ * RETURN: XCB_MOD_MASK_(...) on Success.
+ * RETURN: 0 on Failure (or none).
+ */
+uint16_t
+XCBKeymapGetModifiers(
+        XCBDisplay *display,
+        XCBKeyCode keycode
+        );
 
 
 
@@ -2025,6 +3366,8 @@ XCBKeySymbolsFree(
  * XCB_MAPPIN_KEYBOARD or XCB_MAPPING_MODIFIER occurs. 
  * The result is to update XCB's knowledge of the keyboard. 
  *
+ * NOTE: Only syms is refreshed, the display keymap (XCBKeymapGetKeycodes()) refreshes itself.
+ *
  *
  * RETURN: 1 on Success.
  * RETURN: 0 on Failure.
@@ -2052,6 +3395,65 @@ XCBGetKeyboardMappingReply(
         XCBDisplay *display, 
         XCBCookie cookie);
 
+XCBCookie
+XCBGetModifierMappingCookie(
+        XCBDisplay *display);
+
+/* Gets the keycodes of each modifier, keycodes_per_modifier of them for Shift, Lock, Control, Mod1...Mod5 in turn (0 is unused).
+ *
+ * NOTE: reply must be freed by caller.
+ * NOTE: See XCBKeymapGetModifierMasks() for the cached masks.
+ *
+ * RETURN: XCBKeyboardModifier * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBKeyboardModifier *
+XCBGetModifierMappingReply(
+        XCBDisplay *display,
+        XCBCookie cookie);
+
+XCBCookie
+XCBXineramaIsActiveCookie(
+        XCBDisplay *display);
+
+/*
+ * NOTE: reply must be freed by caller.
+ *
+ * RETURN: XCBXineramaIsActive * on Success, state is nonzero if Xinerama is active.
+ * RETURN: NULL on Failure.
+ */
+XCBXineramaIsActive *
+XCBXineramaIsActiveReply(
+        XCBDisplay *display,
+        XCBCookie cookie);
+
+XCBCookie
+XCBXineramaQueryScreensCookie(
+        XCBDisplay *display);
+
+/*
+ * NOTE: reply must be freed by caller.
+ * NOTE: See XCBXineramaQueryScreensInfo() for the screens, or XCBTrackMonitors() for a cached topology.
+ *
+ * RETURN: XCBXineramaQueryScreens * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBXineramaQueryScreens *
+XCBXineramaQueryScreensReply(
+        XCBDisplay *display,
+        XCBCookie cookie);
+
+/* Gets the screens of reply.
+ *
+ * NOTE: Points into reply, DO NOT free().
+ *
+ * RETURN: Array of length_return XCBXineramaScreenInfo.
+ */
+XCBXineramaScreenInfo *
+XCBXineramaQueryScreensInfo(
+        XCBXineramaQueryScreens *reply,
+        int *length_return);
+
 /* Send a event to the XServer to map the window specified;
  *
  * RETURN: Cookie to request.
@@ -2172,7 +3574,13 @@ XCBSetLineAttributes(
  * data:                                        The property data.
  * 
  * nelements:                                   Specifies the number of elements.
- * RETURN: Cookie to request.
+ *
+ * NOTE: Data too big for 1 request (see XCBGetMaximumRequestLength()) is split into several,
+ *       a Replace (or the given mode) followed by Appends, or Prepends from the last chunk back for XCB_PROP_MODE_PREPEND.
+ *       Other clients may see the property part way through, and get a PropertyNotify per request.
+ * NOTE: Splitting asks for BIG-REQUESTS, which blocks the first time unless XCBPrefetchMaximumRequestLength() was called earlier.
+ *
+ * RETURN: Cookie to request (the last one if split).
 */
 XCBCookie
 XCBChangeProperty(
@@ -2255,6 +3663,13 @@ XCBChangeGC(
         uint32_t valuemask, 
         const void *valuelist);
 
+/* PolyPoint, points too many for 1 request (see XCBGetMaximumRequestLength()) are split into several.
+ *
+ * NOTE: XCB_COORD_MODE_PREVIOUS is kept across the split, every request after the first starts from the absolute position.
+ * NOTE: Splitting asks for BIG-REQUESTS, which blocks the first time unless XCBPrefetchMaximumRequestLength() was called earlier.
+ *
+ * RETURN: Cookie to request (the last one if split).
+ */
 XCBCookie
 XCBDrawPoint(
         XCBDisplay *display,
@@ -2434,6 +3849,77 @@ XCBGetWMNormalHintsReply(
         XCBSizeHints *hints_return
         );
 
+/* XCBTreeScan.valid bits, set for each part of a window that arrived (and was set for properties). */
+enum
+{
+    XCB_SCAN_ATTRIBUTES = 1 << 0,
+    XCB_SCAN_GEOMETRY = 1 << 1,
+    XCB_SCAN_WM_HINTS = 1 << 2,
+    XCB_SCAN_WM_NORMAL_HINTS = 1 << 3,
+    XCB_SCAN_WM_CLASS = 1 << 4,
+    XCB_SCAN_WM_TRANSIENT_FOR = 1 << 5,
+    XCB_SCAN_NET_WM_STATE = 1 << 6,
+    XCB_SCAN_NET_WM_WINDOW_TYPE = 1 << 7,
+};
+
+/* See XCBScanTree(), every array is count long and indexed the same as windows. */
+struct XCBTreeScan
+{
+    uint32_t count;
+    XCBWindow *windows;             /* in stacking order, bottom first */
+    uint8_t *valid;                 /* XCB_SCAN_* */
+    /* GetWindowAttributes */
+    uint8_t *map_state;
+    uint8_t *override_redirect;
+    uint16_t *window_class;         /* XCB_WINDOW_CLASS_* */
+    /* GetGeometry */
+    int16_t *x;
+    int16_t *y;
+    uint16_t *width;
+    uint16_t *height;
+    uint16_t *border_width;
+    /* properties */
+    XCBWMHints *wm_hints;
+    XCBSizeHints *size_hints;
+    const char **instance_name;     /* WM_CLASS, "" if not set */
+    const char **class_name;
+    XCBWindow *transient_for;
+    uint32_t *state_index;          /* _NET_WM_STATE is atoms[state_index[i]] ... atoms[state_index[i] + state_count[i] - 1] */
+    uint32_t *state_count;
+    uint32_t *type_index;           /* _NET_WM_WINDOW_TYPE, same as above */
+    uint32_t *type_count;
+    XCBAtom *atoms;
+    /* timing in nanoseconds */
+    uint64_t tree_ns;               /* QueryTree (and interning) round trip */
+    uint64_t send_ns;               /* queuing every request */
+    uint64_t wait_ns;               /* flushing and reading every reply */
+    uint64_t decode_ns;             /* filling this table */
+    uint32_t requests;              /* requests in the burst */
+};
+
+/* Scans every child of root at once, for adopting existing windows at startup.
+ * After 1 QueryTree the attributes, geometry, WM_HINTS, WM_NORMAL_HINTS, WM_CLASS, WM_TRANSIENT_FOR,
+ * _NET_WM_STATE and _NET_WM_WINDOW_TYPE of every child are requested in 1 burst, flushed once,
+ * and decoded into a single allocation, so the cost is 2 round trips no matter how many windows there are.
+ *
+ * NOTE: Windows that go away during the scan are kept, with valid left 0.
+ * NOTE: Errors are NOT passed to the error handler.
+ * NOTE: RETURN MUST BE RELEASED BY CALLER USING XCBFreeTreeScan().
+ *
+ * RETURN: XCBTreeScan * on Success.
+ * RETURN: NULL on Failure.
+ */
+XCBTreeScan *
+XCBScanTree(
+        XCBDisplay *display,
+        XCBWindow root
+        );
+
+void
+XCBFreeTreeScan(
+        XCBTreeScan *scan
+        );
+
 
 
 
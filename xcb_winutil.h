@@ -108,6 +108,8 @@ enum WMPROTOCOLS {
  * NOTE: No side-effects if wm_atom_return is NULL.
  * NOTE: No side-effects if net_atom_return is NULL.
  * NOTE: XCBInitAtoms() assumes that the space given is enough, ie WMLast or NetLast for array size 
+ * NOTE: Every atom is requested in a single burst and cached on the display, see XCBInternAtoms().
+ * NOTE: Entries with no known name are set to XCB_NONE.
  * 
  */
 void XCBInitAtoms(